@@ -0,0 +1,166 @@
+#!/bin/bash
+#
+# Benchmark script.
+# Prepares, generates and renders a fixed corpus of inputs at a few perfection
+# thresholds, timing each case several times, and writes the results as JSON.
+# The first argument is the path to the sxp cli program.
+# The second argument is the file to write the JSON results to.
+# The third, if given and not empty, is a results file from an earlier run to
+# compare against. The script fails if any case got slower or used more memory
+# than it by more than the percentage given as the fourth argument (default 10).
+#
+# These environment variables change what is run:
+# BENCH_SIZES       sizes of input to generate in bytes
+# BENCH_THRESHOLDS  perfection thresholds to generate with
+# BENCH_RUNS        number of times to run each case
+# BENCH_LINES       most lines to generate of each input, so large inputs are
+#                   prepared and rendered in full but only partly solved
+#
+SXBP="$1";
+RESULTS="$2";
+BASELINE="$3";
+THRESHOLD="${4:-10}";
+SIZES="${BENCH_SIZES:-8 64 512 4096 32768}";
+THRESHOLDS="${BENCH_THRESHOLDS:-1 4}";
+RUNS="${BENCH_RUNS:-5}";
+LINES="${BENCH_LINES:-200}";
+# differences in time smaller than this are put down to noise
+NOISE_SECONDS=0.01;
+
+if [ -z "$SXBP" ] || [ -z "$RESULTS" ]; then
+    echo "Usage: $0 <sxbp> <results.json> [baseline.json] [threshold %]" >&2;
+    exit 2;
+fi
+# run a program in the current directory if that's where it is
+case "$SXBP" in
+    */*) ;;
+    *) SXBP="./$SXBP";;
+esac
+
+WORK_DIR="$(mktemp -d)" || exit 1;
+trap 'rm -rf "$WORK_DIR"' EXIT;
+
+# writes $2 bytes of the pattern named $1 to stdout. random data comes from a
+# fixed-seed LCG, so it's the same on every machine and every run
+make_input() {
+    local pattern="$1" size="$2" state=20161116 chunk="" i byte;
+    for ((i = 0; i < size; i++)); do
+        case "$pattern" in
+            zeros) byte=0;;
+            ones) byte=255;;
+            alternating) byte=170;;
+            random)
+                state=$(( (state * 1103515245 + 12345) & 0x7fffffff ));
+                byte=$(( (state >> 16) & 255 ));;
+        esac
+        chunk+="$(printf '\\x%02x' "$byte")";
+        # write out in chunks, or the string gets slow to append to
+        if (( ${#chunk} >= 4096 )); then
+            printf "$chunk";
+            chunk="";
+        fi
+    done
+    printf "$chunk";
+}
+
+# prints the value of the first JSON field with the given name in the given
+# file, only works for numbers on the same line as their name
+json_number() {
+    sed -n "s/.*\"$1\": *\([-0-9.e]*\).*/\1/p" "$2" | head -n 1;
+}
+
+# prints the total wall-clock time of all phases in a --stats file
+total_seconds() {
+    sed -n 's/.*"wall_seconds": *\([0-9.]*\).*/\1/p' "$1" |
+    awk '{ total += $1 } END { printf "%.6f\n", total }';
+}
+
+# reads numbers on stdin, prints their median and 95th percentile
+summarise() {
+    sort -g | awk '
+        { values[NR] = $1 }
+        END {
+            if(NR % 2) {
+                median = values[(NR + 1) / 2];
+            } else {
+                median = (values[NR / 2] + values[NR / 2 + 1]) / 2;
+            }
+            rank = int(NR * 0.95);
+            if(rank < NR * 0.95) { rank++ }
+            printf "%.6f %.6f\n", median, values[rank];
+        }';
+}
+
+echo "Benchmarking $("$SXBP" -v)";
+{
+    echo "{";
+    echo "  \"program\": \"$("$SXBP" -v)\",";
+    echo "  \"runs\": $RUNS,";
+    echo "  \"cases\": [";
+} > "$RESULTS";
+separator="";
+for pattern in random zeros ones alternating; do
+    for size in $SIZES; do
+        input="$WORK_DIR/$pattern-$size.bin";
+        make_input "$pattern" "$size" > "$input";
+        for threshold in $THRESHOLDS; do
+            name="$pattern-$size-d$threshold";
+            times="";
+            peak=0;
+            for ((run = 0; run < RUNS; run++)); do
+                if ! "$SXBP" -pgr -d "$threshold" -t "$LINES" -i "$input" \
+                    -o "$WORK_DIR/out.pbm" --stats="$WORK_DIR/stats.json"; then
+                    echo "Case $name failed" >&2;
+                    exit 1;
+                fi
+                times+="$(total_seconds "$WORK_DIR/stats.json")"$'\n';
+                rss="$(json_number peak_rss_kib "$WORK_DIR/stats.json")";
+                # the peak isn't known on every platform
+                if [ -n "$rss" ] && (( rss > peak )); then
+                    peak="$rss";
+                fi
+            done
+            read -r median p95 <<< "$(printf "%s" "$times" | summarise)";
+            echo "  $name: median ${median}s, p95 ${p95}s, peak ${peak} KiB";
+            printf '%s    {"name": "%s", "median_seconds": %s, ' \
+                "$separator" "$name" "$median" >> "$RESULTS";
+            printf '"p95_seconds": %s, "peak_rss_kib": %s}' \
+                "$p95" "$peak" >> "$RESULTS";
+            separator=$',\n';
+        done
+    done
+done
+printf '\n  ]\n}\n' >> "$RESULTS";
+
+if [ -z "$BASELINE" ]; then
+    exit 0;
+fi
+# compare each case with the same case in the baseline, if it has it
+echo "Comparing with $BASELINE (threshold $THRESHOLD%)";
+extract_cases() {
+    local pattern='.*"name": "\([^"]*\)", "median_seconds": \([0-9.]*\), ';
+    pattern+='"p95_seconds": [0-9.]*, "peak_rss_kib": \([0-9]*\).*';
+    sed -n "s/$pattern/\1 \2 \3/p" "$1";
+}
+awk -v threshold="$THRESHOLD" -v noise="$NOISE_SECONDS" '
+    FNR == NR { seconds[$1] = $2; memory[$1] = $3; next }
+    !($1 in seconds) { next }
+    {
+        limit = 1 + threshold / 100;
+        if(($2 > seconds[$1] * limit) && ($2 - seconds[$1] > noise)) {
+            printf "  %s: %.6fs is slower than %.6fs\n", $1, $2, seconds[$1];
+            failed++;
+        }
+        if($3 > memory[$1] * limit) {
+            printf "  %s: %d KiB is more than %d KiB\n", $1, $3, memory[$1];
+            failed++;
+        }
+    }
+    END {
+        if(failed) {
+            printf "%d regressions found\n", failed;
+            exit 1;
+        }
+        print "No regressions found";
+    }
+' <(extract_cases "$BASELINE") <(extract_cases "$RESULTS");
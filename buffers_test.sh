@@ -0,0 +1,53 @@
+#!/bin/bash
+#
+# Functional test script for the buffer pool.
+# Checks that saving checkpoints and running jobs one after another reuse the
+# buffers of earlier outputs instead of allocating more, using the buffer
+# counts given by --stats.
+# The first argument is the path to the sxp cli program.
+#
+SXBP="$PWD/$1";
+WORK_DIR="$(mktemp -d)" || exit 1;
+trap 'rm -rf "$WORK_DIR"' EXIT;
+cd "$WORK_DIR" || exit 1;
+
+# prints the buffer count of the given name in the given --stats file
+buffer_count() {
+    sed -n "s/.*\"buffers\":.*\"$1\": *\([0-9]*\).*/\1/p" "$2";
+}
+
+# runs sxbp with the given lines to generate and any other options given,
+# writing statistics to stats.json
+generate() {
+    local lines="$1";
+    shift;
+    "$SXBP" -pg -i "input.bin" -t "$lines" -o "output.sxp" \
+        --sxp-format=v2z --stats="stats.json" "$@" || exit 1;
+}
+
+echo "Testing buffer reuse";
+# all zeros is slow enough to solve that checkpoints are saved in between
+head -c 64 /dev/zero > "input.bin";
+generate 100;
+allocated="$(buffer_count allocated "stats.json")";
+previous=0;
+for lines in 100 150; do
+    generate "$lines" -s 1;
+    if [ "$(buffer_count allocated "stats.json")" != "$allocated" ] || \
+        (( $(buffer_count reused "stats.json") <= previous )); then
+        echo "Checkpoints to line $lines allocated more buffers" >&2;
+        exit 1;
+    fi
+    previous="$(buffer_count reused "stats.json")";
+done
+# the second job gets the buffers the first one finished with
+printf "input.bin first.sxp\ninput.bin second.sxp\n" > "manifest";
+"$SXBP" -pg -t 100 -b "manifest" -j 1 --sxp-format=v2z \
+    --stats="stats.json" || exit 1;
+if [ "$(buffer_count allocated "stats.000000.json")" != "$allocated" ] || \
+    [ "$(buffer_count allocated "stats.000001.json")" != 0 ] || \
+    (( $(buffer_count reused "stats.000001.json") == 0 )); then
+    echo "The second batch job allocated more buffers" >&2;
+    exit 1;
+fi
+exit 0;
@@ -0,0 +1,48 @@
+#!/bin/bash
+#
+# Functional test script for the sxp file formats.
+# Checks that spirals convert between the v1, v2 and v2z formats unchanged,
+# that a v2 spiral generated in two goes matches one generated in one, and
+# that damaged v2 files are refused with the right diagnostic.
+# The first argument is the path to the sxp cli program.
+# The second argument is the message to use for the spiral data.
+#
+SXBP="$PWD/$1";
+MESSAGE="$2";
+WORK_DIR="$(mktemp -d)" || exit 1;
+trap 'rm -rf "$WORK_DIR"' EXIT;
+cd "$WORK_DIR" || exit 1;
+
+# fails unless loading the file given gives the file error code given
+expect_diagnostic() {
+    local output;
+    output="$("$SXBP" -r -i "$1" -o "broken.pbm" 2>&1)";
+    if [ $? -eq 0 ] || [[ "$output" != *"File Error Code:"*"$2"* ]]; then
+        echo "Loading $1 didn't fail with $2" >&2;
+        exit 1;
+    fi
+}
+
+echo "Testing sxp formats";
+"$SXBP" -pgS "$MESSAGE" -o "v1.sxp" || exit 1;
+for format in v2 v2z; do
+    "$SXBP" -g -i "v1.sxp" -o "$format.sxp" --sxp-format="$format" && \
+    "$SXBP" -g -i "$format.sxp" -o "$format-v1.sxp" --sxp-format=v1 && \
+    cmp "v1.sxp" "$format-v1.sxp" || exit 1;
+done
+# generate part of the spiral, then carry on to the end
+"$SXBP" -pgS "$MESSAGE" -t 60 -o "part.sxp" --sxp-format=v2 && \
+"$SXBP" -g -i "part.sxp" -o "part.sxp" --sxp-format=v2 && \
+"$SXBP" -g -i "part.sxp" -o "part-v1.sxp" --sxp-format=v1 && \
+cmp "v1.sxp" "part-v1.sxp" || exit 1;
+# too short for a header, but with the v2 magic number
+head -c 12 "v2.sxp" > "short.sxp";
+expect_diagnostic "short.sxp" "DESERIALISE_BAD_HEADER_SIZE";
+{ printf "X"; tail -c +2 "v2.sxp"; } > "magic.sxp";
+expect_diagnostic "magic.sxp" "DESERIALISE_BAD_MAGIC_NUMBER";
+# a flag from a newer version
+{ head -c 8 "v2.sxp"; printf "\x80"; tail -c +10 "v2.sxp"; } > "flags.sxp";
+expect_diagnostic "flags.sxp" "DESERIALISE_BAD_VERSION";
+head -c 40 "v2.sxp" > "truncated.sxp";
+expect_diagnostic "truncated.sxp" "DESERIALISE_BAD_DATA_SIZE";
+exit 0;
@@ -0,0 +1,54 @@
+#!/bin/bash
+#
+# Functional test script for checkpoint journals.
+# Kills a run writing a journal part way through, then checks that resuming
+# it gives the same spiral as generating it in one go, and that a journal
+# written for a different spiral file is ignored.
+# The first argument is the path to the sxp cli program.
+#
+SXBP="$PWD/$1";
+LINES=200;
+WORK_DIR="$(mktemp -d)" || exit 1;
+trap 'rm -rf "$WORK_DIR"' EXIT;
+cd "$WORK_DIR" || exit 1;
+
+echo "Testing journals";
+# all zeros is slow enough to solve that there's time to stop it part way
+head -c 64 /dev/zero > "input.bin";
+"$SXBP" -pg -i "input.bin" -t "$LINES" -o "direct.sxp" || exit 1;
+"$SXBP" -pg -i "input.bin" -t "$LINES" -s 10 --journal -o "data.sxp" &
+pid=$!;
+# wait for a record after the journal's header, then crash
+while kill -0 "$pid" 2> /dev/null; do
+    if (( $(stat -c "%s" "data.sxp.sxj" 2> /dev/null || echo 0) > 22 )); then
+        kill -9 "$pid";
+        break;
+    fi
+    sleep 0.01;
+done
+wait "$pid" 2> /dev/null;
+if ! [ -f "data.sxp.sxj" ]; then
+    echo "The run finished before it could be stopped" >&2;
+    exit 1;
+fi
+# the same journal next to another spiral mustn't be replayed onto it
+"$SXBP" -pg -i "input.bin" -t 20 -o "other.sxp" && \
+cp "data.sxp.sxj" "other.sxp.sxj" && \
+"$SXBP" -g -i "other.sxp" -t 40 -o "other-resumed.sxp" --resume && \
+"$SXBP" -g -i "other.sxp" -t 40 -o "other-direct.sxp" && \
+cmp "other-direct.sxp" "other-resumed.sxp" || exit 1;
+# the journal holds lines solved after the spiral file was last written
+"$SXBP" -r -i "data.sxp" -o "plain.pbm" && \
+"$SXBP" -r -i "data.sxp" -o "replayed.pbm" --resume || exit 1;
+if cmp -s "plain.pbm" "replayed.pbm"; then
+    echo "Resuming didn't replay the journal" >&2;
+    exit 1;
+fi
+"$SXBP" -g -i "data.sxp" -t "$LINES" -s 10 --journal --resume \
+    -o "data.sxp" && \
+cmp "direct.sxp" "data.sxp" || exit 1;
+if [ -f "data.sxp.sxj" ]; then
+    echo "The journal wasn't removed once the spiral was written" >&2;
+    exit 1;
+fi
+exit 0;
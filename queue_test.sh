@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# Functional test script for queue mode.
+# Runs two workers over a queue of jobs and checks each job's output lands in
+# done/ once, then kills a worker part way through a job and checks another
+# takes it over once its lease expires, carrying on from its checkpoint.
+# The first argument is the path to the sxp cli program.
+#
+SXBP="$PWD/$1";
+JOBS=6;
+WORK_DIR="$(mktemp -d)" || exit 1;
+trap 'rm -rf "$WORK_DIR"' EXIT;
+cd "$WORK_DIR" || exit 1;
+
+# fails unless only the given files are in the given directory
+expect_files() {
+    local listing;
+    listing="$(cd "$1" && ls -A)";
+    if [ "$listing" != "$2" ]; then
+        echo "Expected $1 to hold '$2' but it holds '$listing'" >&2;
+        exit 1;
+    fi
+}
+
+echo "Testing queue mode";
+mkdir -p "queue/pending" "direct";
+for ((job = 0; job < JOBS; job++)); do
+    printf "queue job %d" "$job" > "job$job";
+    "$SXBP" -pg -i "job$job" -o "direct/job$job.sxp" || exit 1;
+    mv "job$job" "queue/pending/";
+done
+"$SXBP" -pg --queue-dir="queue" & first=$!;
+"$SXBP" -pg --queue-dir="queue" & second=$!;
+wait "$first" && wait "$second" || exit 1;
+expect_files "queue/done" "$(cd "direct" && ls -A)";
+for state in pending active checkpoints failed; do
+    expect_files "queue/$state" "";
+done
+for output in "direct/"*; do
+    cmp "$output" "queue/done/${output#direct/}" || exit 1;
+done
+# all zeros is slow enough to solve that there's time to stop it part way
+rm -rf "queue";
+mkdir -p "queue/pending";
+head -c 64 /dev/zero > "queue/pending/zeros";
+"$SXBP" -pg -t 200 -i "queue/pending/zeros" -o "zeros.sxp" || exit 1;
+"$SXBP" -pg -t 200 -s 10 --lease=1 --queue-dir="queue" 2> /dev/null &
+pid=$!;
+# wait for a checkpoint of the job, then crash
+while kill -0 "$pid" 2> /dev/null; do
+    if compgen -G "queue/active/*/output.sxp" > /dev/null; then
+        kill -9 "$pid";
+        break;
+    fi
+    sleep 0.01;
+done
+wait "$pid" 2> /dev/null;
+expect_files "queue/done" "";
+"$SXBP" -pg -t 200 -s 10 --lease=1 --queue-dir="queue" 2> "worker.log" || \
+    exit 1;
+if ! grep -q "Resuming job from checkpoint: zeros" "worker.log"; then
+    echo "The job wasn't carried on from its checkpoint" >&2;
+    exit 1;
+fi
+expect_files "queue/done" "zeros.sxp";
+cmp "zeros.sxp" "queue/done/zeros.sxp" || exit 1;
+exit 0;
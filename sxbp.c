@@ -21,13 +21,37 @@
  * You should have received a copy of the GNU Affero General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+// needed for POSIX threads and directory listing when compiling as strict C99
+#define _POSIX_C_SOURCE 200809L
+// O_DIRECT is a Linux extension, only declared when GNU extensions are wanted
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
 #include <argtable2.h>
+#include <zlib.h>
 #include <sxbp-0/saxbospiral.h>
 #include <sxbp-0/initialise.h>
 #include <sxbp-0/solve.h>
@@ -41,87 +65,356 @@
 extern "C"{
 #endif
 
-// returns size of file associated with given file handle
-static size_t get_file_size(FILE* file_handle) {
-    // seek to end
-    fseek(file_handle, 0L, SEEK_END);
-    // get size
-    size_t file_size = ftell(file_handle);
-    // seek to start again
-    fseek(file_handle, 0L, SEEK_SET);
-    return file_size;
+/*
+ * the buffer pool, which keeps hold of the big buffers that spirals are
+ * serialised, rendered and written out through once they're finished with, so
+ * that the next ones needed can reuse them instead of allocating their own.
+ * every checkpoint of a run, and every output of every job the process runs,
+ * needs much the same buffers, so once the pool has them, it stops allocating.
+ */
+// most buffers the pool keeps hold of at once
+#define BUFFER_POOL_SLOTS 32
+// most memory the pool keeps hold of at once, buffers beyond it are freed
+#define BUFFER_POOL_MAX_SIZE (64 * 1024 * 1024)
+// alignment of pooled buffers, which O_DIRECT needs to be that of a page
+#define BUFFER_POOL_ALIGNMENT 4096
+
+// private structure, a buffer the pool is keeping hold of
+struct pooled_buffer_t {
+    void* bytes;
+    size_t capacity;
+};
+
+// private structure, the buffer pool shared by all threads
+struct buffer_pool_t {
+    struct pooled_buffer_t idle[BUFFER_POOL_SLOTS]; // buffers not in use
+    size_t idle_count; // number of buffers not in use
+    size_t idle_size; // total capacity of the buffers not in use
+    uint64_t allocated; // number of buffers that had to be allocated afresh
+    uint64_t reused; // number of buffers handed out again instead
+    pthread_mutex_t lock; // guards all of the above
+};
+
+static struct buffer_pool_t buffer_pool = {
+    .idle_count = 0,
+    .idle_size = 0,
+    .allocated = 0,
+    .reused = 0,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * private function, returns a page-aligned buffer of at least the given size,
+ * reusing the smallest one in the pool that's big enough if there is one, and
+ * allocating one otherwise. what's in it is left as it was. capacity is set to
+ * the buffer's actual size, which it must be given back to release_buffer()
+ * with.
+ * returns NULL if memory couldn't be allocated for it.
+ */
+static void* acquire_buffer(size_t size, size_t* capacity) {
+    pthread_mutex_lock(&buffer_pool.lock);
+    size_t best = buffer_pool.idle_count;
+    for(size_t i = 0; i < buffer_pool.idle_count; i++) {
+        if(
+            (buffer_pool.idle[i].capacity >= size) &&
+            (
+                (best == buffer_pool.idle_count) ||
+                (buffer_pool.idle[i].capacity < buffer_pool.idle[best].capacity)
+            )
+        ) {
+            best = i;
+        }
+    }
+    if(best < buffer_pool.idle_count) {
+        struct pooled_buffer_t buffer = buffer_pool.idle[best];
+        buffer_pool.idle[best] = buffer_pool.idle[--buffer_pool.idle_count];
+        buffer_pool.idle_size -= buffer.capacity;
+        buffer_pool.reused++;
+        pthread_mutex_unlock(&buffer_pool.lock);
+        *capacity = buffer.capacity;
+        return buffer.bytes;
+    }
+    buffer_pool.allocated++;
+    pthread_mutex_unlock(&buffer_pool.lock);
+    // whole pages, so that a slightly bigger size next time still fits
+    if(size > SIZE_MAX - BUFFER_POOL_ALIGNMENT) {
+        return NULL;
+    }
+    size_t rounded = (
+        (size + BUFFER_POOL_ALIGNMENT - 1) / BUFFER_POOL_ALIGNMENT *
+        BUFFER_POOL_ALIGNMENT
+    );
+    rounded = (rounded > 0) ? rounded : BUFFER_POOL_ALIGNMENT;
+    void* bytes = NULL;
+    if(posix_memalign(&bytes, BUFFER_POOL_ALIGNMENT, rounded) != 0) {
+        return NULL;
+    }
+    *capacity = rounded;
+    return bytes;
 }
 
 /*
- * given an open file handle and a buffer, read the file contents into buffer
- * returns true on success and false on failure.
+ * private function, gives a buffer from acquire_buffer() back to the pool, to
+ * be reused. if the pool is full, its smallest buffers, which are the likeliest
+ * to have been outgrown, are freed to make room. bytes may be NULL.
  */
-static bool file_to_buffer(FILE* file_handle, sxbp_buffer_t* buffer) {
-    size_t file_size = get_file_size(file_handle);
-    // allocate/re-allocate buffer memory
-    if(buffer->bytes == NULL) {
-        buffer->bytes = calloc(1, file_size);
-    } else {
-        buffer->bytes = realloc(buffer->bytes, file_size);
+static void release_buffer(void* bytes, size_t capacity) {
+    if(bytes == NULL) {
+        return;
     }
-    if(buffer->bytes == NULL) {
-        // couldn't allocate enough memory!
-        return false;
+    void* evicted[BUFFER_POOL_SLOTS];
+    size_t evicted_count = 0;
+    pthread_mutex_lock(&buffer_pool.lock);
+    if(capacity <= BUFFER_POOL_MAX_SIZE) {
+        while(
+            (buffer_pool.idle_count == BUFFER_POOL_SLOTS) ||
+            (buffer_pool.idle_size + capacity > BUFFER_POOL_MAX_SIZE)
+        ) {
+            size_t smallest = 0;
+            for(size_t i = 1; i < buffer_pool.idle_count; i++) {
+                if(
+                    buffer_pool.idle[i].capacity <
+                    buffer_pool.idle[smallest].capacity
+                ) {
+                    smallest = i;
+                }
+            }
+            evicted[evicted_count++] = buffer_pool.idle[smallest].bytes;
+            buffer_pool.idle_size -= buffer_pool.idle[smallest].capacity;
+            buffer_pool.idle[smallest] = (
+                buffer_pool.idle[--buffer_pool.idle_count]
+            );
+        }
+        buffer_pool.idle[buffer_pool.idle_count++] = (struct pooled_buffer_t){
+            bytes, capacity,
+        };
+        buffer_pool.idle_size += capacity;
+        bytes = NULL;
     }
-    buffer->size = file_size;
-    // read in file data to buffer
-    size_t bytes_read = fread(buffer->bytes, 1, file_size, file_handle);
-    // check amount read was the size of file
-    if(bytes_read != file_size) {
-        // free memory
-        free(buffer->bytes);
-        return false;
-    } else {
-        return true;
+    pthread_mutex_unlock(&buffer_pool.lock);
+    // free outside of the lock, so other threads aren't kept waiting
+    free(bytes);
+    for(size_t i = 0; i < evicted_count; i++) {
+        free(evicted[i]);
     }
 }
 
 /*
- * given a C-style string and a buffer, reads the string into the buffer
- * returns true on success and false on failure.
+ * private function, gets how many buffers have been allocated for the pool,
+ * and how many times one has been reused, since the program started
  */
-static bool string_to_buffer(const char* input_string, sxbp_buffer_t* buffer) {
-    // get string length
-    size_t input_length = strlen(input_string);
-    // allocate buffer memory
-    buffer->bytes = calloc(1, input_length);
-    if(buffer->bytes == NULL) {
-        // couldn't allocate memory!
-        return false;
+static void buffer_pool_counts(uint64_t* allocated, uint64_t* reused) {
+    pthread_mutex_lock(&buffer_pool.lock);
+    *allocated = buffer_pool.allocated;
+    *reused = buffer_pool.reused;
+    pthread_mutex_unlock(&buffer_pool.lock);
+}
+
+// size of the first chunk read from streams which can't be sized up front
+#define READ_CHUNK_SIZE 65536
+
+/*
+ * given an open file handle and a buffer, read the rest of the file contents
+ * into buffer. the buffer is grown as the data comes in, so this works for
+ * pipes and other streams which can't be sized or seeked.
+ * returns true on success and false on failure, in which case the buffer is
+ * left empty.
+ */
+static bool file_to_buffer(FILE* file_handle, sxbp_buffer_t* buffer) {
+    uint8_t* bytes = NULL;
+    size_t capacity = 0;
+    size_t size = 0;
+    bool ok = true;
+    while(ok) {
+        if(size == capacity) {
+            // grow geometrically so that reading big inputs is linear time
+            size_t new_capacity = (
+                (capacity == 0) ? READ_CHUNK_SIZE : capacity * 2
+            );
+            uint8_t* grown = (
+                (new_capacity > capacity) ? realloc(bytes, new_capacity) : NULL
+            );
+            if(grown == NULL) {
+                // couldn't allocate enough memory!
+                ok = false;
+                break;
+            }
+            bytes = grown;
+            capacity = new_capacity;
+        }
+        size_t bytes_read = fread(
+            bytes + size, 1, capacity - size, file_handle
+        );
+        size += bytes_read;
+        if(bytes_read == 0) {
+            // either the end of the file or an error, find out which
+            ok = (ferror(file_handle) == 0);
+            break;
+        }
     }
-    buffer->size = input_length;
-    // copy data from string to buffer
-    void* result = memcpy(buffer->bytes, input_string, input_length);
-    // return true if memcpy result points to something
-    if(result != NULL) {
-        return true;
-    } else {
-        // free memory and return false
-        free(buffer->bytes);
+    if(!ok) {
+        free(bytes);
         return false;
     }
+    // give back what we didn't use, it doesn't matter if this fails
+    if(size > 0) {
+        uint8_t* shrunk = realloc(bytes, size);
+        if(shrunk != NULL) {
+            bytes = shrunk;
+        }
+    }
+    free(buffer->bytes);
+    buffer->bytes = bytes;
+    buffer->size = size;
+    return true;
+}
+
+// private enumeration, how the memory behind an input buffer was obtained
+enum input_storage_t {
+    INPUT_STORAGE_HEAP, // allocated by us, to be freed
+    INPUT_STORAGE_MAPPED, // a file mapped into memory, to be unmapped
+    INPUT_STORAGE_BORROWED, // someone else's memory, to be left alone
+};
+
+/*
+ * private structure, the data the spiral is prepared or loaded from. this is
+ * kept read-only, so it can point straight at a mapped file or a string
+ * instead of a copy of it.
+ */
+struct input_buffer_t {
+    sxbp_buffer_t buffer;
+    enum input_storage_t storage;
+};
+
+/*
+ * private function, given a C-style string, points the input buffer at it.
+ * the string must outlive the input buffer.
+ */
+static void string_to_input(
+    const char* input_string, struct input_buffer_t* input
+) {
+    // libsxbp only ever reads from input buffers, so no copy is needed
+    input->buffer.bytes = (uint8_t*)input_string;
+    input->buffer.size = strlen(input_string);
+    input->storage = INPUT_STORAGE_BORROWED;
+}
+
+/*
+ * buffers that stand in for stdin and stdout on the threads which have them,
+ * so that a daemon job can be given its input and return its output inline
+ * instead of through files. each thread has its own, NULL means the real ones.
+ */
+static pthread_key_t standard_input_key;
+static pthread_key_t standard_output_key;
+// makes sure the keys are only created once
+static pthread_once_t standard_keys_once = PTHREAD_ONCE_INIT;
+
+// private function, creates the keys of the stand-in stdin and stdout buffers
+static void create_standard_keys(void) {
+    pthread_key_create(&standard_input_key, NULL);
+    pthread_key_create(&standard_output_key, NULL);
+}
+
+/*
+ * private function, sets the buffers standing in for stdin and stdout on the
+ * calling thread. the input is only read, the output is appended to. either
+ * can be NULL to use the real one again.
+ */
+static void set_standard_buffers(
+    const sxbp_buffer_t* input, sxbp_buffer_t* output
+) {
+    pthread_once(&standard_keys_once, create_standard_keys);
+    pthread_setspecific(standard_input_key, input);
+    pthread_setspecific(standard_output_key, output);
+}
+
+// private function, returns the calling thread's stand-in stdin, if any
+static const sxbp_buffer_t* standard_input_buffer(void) {
+    pthread_once(&standard_keys_once, create_standard_keys);
+    return pthread_getspecific(standard_input_key);
+}
+
+// private function, returns the calling thread's stand-in stdout, if any
+static sxbp_buffer_t* standard_output_buffer(void) {
+    pthread_once(&standard_keys_once, create_standard_keys);
+    return pthread_getspecific(standard_output_key);
 }
 
 /*
- * given a buffer struct and an open file handle, writes the buffer contents
- * to the file.
+ * private function, given a file path, makes the file's contents available in
+ * the input buffer. regular files are mapped into memory rather than copied,
+ * anything else is read in chunks. the path "-" means standard input.
  * returns true on success and false on failure.
  */
-static bool buffer_to_file(sxbp_buffer_t* buffer, FILE* file_handle) {
-    size_t bytes_written = fwrite(
-        buffer->bytes, 1, buffer->size, file_handle
-    );
-    // check amount written was the size of buffer
-    if(bytes_written != buffer->size) {
+static bool path_to_input(const char* path, struct input_buffer_t* input) {
+    input->buffer.bytes = NULL;
+    input->buffer.size = 0;
+    input->storage = INPUT_STORAGE_HEAP;
+    if(strcmp(path, "-") == 0) {
+        const sxbp_buffer_t* standard_input = standard_input_buffer();
+        if(standard_input != NULL) {
+            input->buffer = *standard_input;
+            input->storage = INPUT_STORAGE_BORROWED;
+            return true;
+        }
+        return file_to_buffer(stdin, &input->buffer);
+    }
+    int descriptor = open(path, O_RDONLY);
+    if(descriptor == -1) {
+        fprintf(stderr, "%s\n", "Couldn't open input file");
         return false;
-    } else {
-        return true;
     }
+    struct stat status;
+    if(
+        (fstat(descriptor, &status) == 0) && S_ISREG(status.st_mode) &&
+        (status.st_size > 0) &&
+        ((uintmax_t)status.st_size <= (uintmax_t)SIZE_MAX)
+    ) {
+        /*
+         * NOTE: the mapping stays valid after the descriptor is closed. if the
+         * file is truncated while we're using it we'll get SIGBUS, but it is
+         * no more safe to modify an input while sxbp is reading it than it
+         * ever was.
+         */
+        size_t size = (size_t)status.st_size;
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(mapped != MAP_FAILED) {
+            close(descriptor);
+            // it's all read front to back, so let the kernel read ahead
+            posix_madvise(mapped, size, POSIX_MADV_SEQUENTIAL);
+            input->buffer.bytes = mapped;
+            input->buffer.size = size;
+            input->storage = INPUT_STORAGE_MAPPED;
+            return true;
+        }
+        // if it couldn't be mapped, fall back to reading it the slow way
+    }
+    // pipes, FIFOs, character devices, empty or special files etc...
+    FILE* input_file = fdopen(descriptor, "rb");
+    if(input_file == NULL) {
+        close(descriptor);
+        return false;
+    }
+    bool read_ok = file_to_buffer(input_file, &input->buffer);
+    fclose(input_file);
+    return read_ok;
+}
+
+// private function, releases the memory behind the given input buffer
+static void free_input(struct input_buffer_t* input) {
+    switch(input->storage) {
+        case INPUT_STORAGE_HEAP:
+            free(input->buffer.bytes);
+            break;
+        case INPUT_STORAGE_MAPPED:
+            munmap(input->buffer.bytes, input->buffer.size);
+            break;
+        case INPUT_STORAGE_BORROWED:
+        default:
+            break;
+    }
+    input->buffer.bytes = NULL;
+    input->buffer.size = 0;
 }
 
 /*
@@ -182,426 +475,8262 @@ static bool handle_error(sxbp_status_t result) {
     }
 }
 
-// enum for representing different spiral render modes
-enum spiral_render_mode_t {
-    RENDER_MODE_SXP, RENDER_MODE_PBM, RENDER_MODE_PNG,
+// the phases of a run which are timed when collecting statistics
+enum run_phase_t {
+    PHASE_READ, PHASE_INIT, PHASE_GENERATE, PHASE_SERIALISE, PHASE_WRITE,
+    PHASE_COUNT,
+};
+
+// names of the run phases, as used in the statistics file
+static const char* const RUN_PHASE_NAMES[PHASE_COUNT] = {
+    "read", "init", "generate", "serialise", "write",
 };
 
 /*
- * private structure, used for supplying many a datum to the callback function
- * passed to plot_spiral()
+ * number of buckets in the histogram of time spent per line. bucket n counts
+ * lines which took from 2^n up to 2^(n + 1) microseconds, except the first,
+ * which also counts anything quicker than that
  */
-struct user_data_t {
-    // whether to render to sxp, pbm or png format
-    enum spiral_render_mode_t render_mode;
-    const char* file_path; // path of file to save to
-    uint32_t save_line_interval; // save file every this number of lines
+#define STATS_HISTOGRAM_BUCKETS 40
+/*
+ * the most solve rate samples kept. when there are this many, every other one
+ * is dropped and the sampling interval doubled, so long runs stay bounded
+ */
+#define STATS_MAX_SAMPLES 512
+
+// private structure, wall-clock and CPU time spent in one phase of a run
+struct phase_time_t {
+    double wall_seconds;
+    double cpu_seconds;
+};
+
+// private structure, the progress of the solver at a point in time
+struct solve_sample_t {
+    double seconds; // seconds since the solver started
+    uint32_t solved_count; // number of lines solved by then
 };
 
 /*
- * disable GCC warning about the unused parameter, as this is a callback it must
- * include all arguments specified by the library prototype, even if not used
+ * private structure, statistics collected during a run, for finding out where
+ * the time goes
  */
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-parameter"
+struct run_stats_t {
+    struct phase_time_t phases[PHASE_COUNT]; // time spent in each phase
+    double phase_wall_start; // wall-clock time the current phase started at
+    double phase_cpu_start; // CPU time the current phase started at
+    double solve_start; // wall-clock time the solver started at
+    double last_line_time; // wall-clock time the last line was solved at
+    uint32_t start_solved_count; // lines already solved when solving began
+    uint32_t solved_count; // lines solved as of the last callback
+    uint32_t target_line; // line the solver is solving up to
+    // histogram of time spent solving each line
+    uint64_t line_time_histogram[STATS_HISTOGRAM_BUCKETS];
+    /*
+     * number of times lines before the newest one were found to have changed
+     * since the last callback, which only happens when the solver backtracks.
+     * this is a lower bound, a backtrack which leaves lengths as they were
+     * can't be seen from outside the solver.
+     */
+    uint64_t backtracks;
+    uint64_t lines_revised; // number of line changes seen in backtracks
+    uint32_t* lengths; // copy of line lengths as of the last callback
+    uint32_t lengths_size; // number of lengths there is memory allocated for
+    struct solve_sample_t samples[STATS_MAX_SAMPLES]; // solve rate over time
+    size_t sample_count; // number of samples taken
+    double sample_interval; // seconds between samples
+    double progress_interval; // seconds between progress lines, 0 for none
+    double next_progress; // solve time to print the next progress line at
+    // what was found in the cache, NULL if the cache wasn't used
+    const char* cache_result;
+    uint64_t buffers_allocated; // buffer pool's allocations when run began
+    uint64_t buffers_reused; // buffer pool's reuses when run began
+};
+
+// private function, returns the current time of the given clock in seconds
+static double clock_seconds(clockid_t clock) {
+    struct timespec time;
+    if(clock_gettime(clock, &time) != 0) {
+        return 0.0;
+    }
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+// private function, initialises statistics collection
+static void init_run_stats(
+    struct run_stats_t* stats, double progress_interval
+) {
+    memset(stats, 0, sizeof(struct run_stats_t));
+    stats->lengths = NULL;
+    stats->sample_interval = 1.0;
+    stats->progress_interval = progress_interval;
+    buffer_pool_counts(&stats->buffers_allocated, &stats->buffers_reused);
+}
+
+// private function, marks the start of a phase of a run, if collecting stats
+static void begin_phase(struct run_stats_t* stats) {
+    if(stats != NULL) {
+        stats->phase_wall_start = clock_seconds(CLOCK_MONOTONIC);
+        stats->phase_cpu_start = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    }
+}
+
+// private function, marks the end of a phase of a run, if collecting stats
+static void end_phase(struct run_stats_t* stats, enum run_phase_t phase) {
+    if(stats != NULL) {
+        stats->phases[phase].wall_seconds += (
+            clock_seconds(CLOCK_MONOTONIC) - stats->phase_wall_start
+        );
+        stats->phases[phase].cpu_seconds += (
+            clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - stats->phase_cpu_start
+        );
+    }
+}
+
+// private function, marks the start of solving, if collecting stats
+static void begin_solve(
+    struct run_stats_t* stats, const sxbp_spiral_t* spiral, uint32_t target_line
+) {
+    if(stats != NULL) {
+        stats->solve_start = clock_seconds(CLOCK_MONOTONIC);
+        stats->last_line_time = stats->solve_start;
+        stats->start_solved_count = spiral->solved_count;
+        stats->solved_count = spiral->solved_count;
+        stats->target_line = target_line;
+        stats->next_progress = stats->progress_interval;
+    }
+}
+
 /*
- * private function - callback handler for plot_spiral()
- * saves current spiral state to .sxp or .pbm depending on whether in render
- * mode or not, and on how often it is to save output
+ * private function, records the time taken to solve the latest line, looks for
+ * lines which the solver changed by backtracking, samples the solve rate and
+ * prints progress if it's time to
  */
-static void plot_spiral_callback(
-    sxbp_spiral_t* spiral, uint32_t latest_line, uint32_t target_line,
-    void* user_data_void_pointer
+static void record_solved_line(
+    struct run_stats_t* stats, const sxbp_spiral_t* spiral
 ) {
-    // cast void pointer to our user data type
-    struct user_data_t user_data = *(struct user_data_t*)user_data_void_pointer;
-    // first, check if we need to save this time
-    if(((spiral->solved_count - 1) % user_data.save_line_interval) == 0) {
-        // we do need to save, so check we can open the file first
-        FILE* output_file = fopen(user_data.file_path, "wb");
-        if(output_file != NULL) {
-            // create variable to store return status of serialise operations
-            sxbp_status_t result = SXBP_STATE_UNKNOWN;
-            // create output buffer
-            sxbp_buffer_t output_buffer = {0, 0};
-            // Now, check whether it'll be to sxp
-            if(user_data.render_mode == RENDER_MODE_SXP) {
-                // save to sxp, store result code
-                result = sxbp_dump_spiral(
-                    *spiral, &output_buffer
-                ).status;
-            } else if(user_data.render_mode == RENDER_MODE_PBM) {
-                /*
-                 * render spiral to image, using PBM render function and store
-                 * data in buffer - capture return status to check later
-                 */
-                result = sxbp_render_spiral_image(
-                    *spiral, &output_buffer, sxbp_render_backend_pbm
-                );
-            } else if(user_data.render_mode == RENDER_MODE_PNG) {
-                /*
-                 * render spiral to image, using PNG render function and store
-                 * data in buffer - capture return status to check later
-                 */
-                result = sxbp_render_spiral_image(
-                    *spiral, &output_buffer, sxbp_render_backend_png
-                );
+    double now = clock_seconds(CLOCK_MONOTONIC);
+    // add the time spent on this line to the histogram
+    double microseconds = (now - stats->last_line_time) * 1e6;
+    size_t bucket = 0;
+    while((bucket < STATS_HISTOGRAM_BUCKETS - 1) && (microseconds >= 2.0)) {
+        microseconds /= 2.0;
+        bucket++;
+    }
+    stats->line_time_histogram[bucket]++;
+    stats->last_line_time = now;
+    stats->solved_count = spiral->solved_count;
+    /*
+     * look back from the newest line for lines which have changed since last
+     * time, keeping a copy of the lengths to compare against next time
+     */
+    if(stats->lengths_size < spiral->size) {
+        uint32_t* lengths = realloc(
+            stats->lengths, spiral->size * sizeof(uint32_t)
+        );
+        if(lengths != NULL) {
+            // lines we haven't seen yet count as unchanged
+            for(uint32_t i = stats->lengths_size; i < spiral->size; i++) {
+                lengths[i] = spiral->lines[i].length;
             }
-            // if all was ok, save to file
-            if(result == SXBP_OPERATION_OK) {
-                buffer_to_file(&output_buffer, output_file);
-                fclose(output_file);
+            stats->lengths = lengths;
+            stats->lengths_size = spiral->size;
+        }
+    }
+    if((stats->lengths != NULL) && (spiral->solved_count > 0)) {
+        uint32_t newest = spiral->solved_count - 1;
+        stats->lengths[newest] = spiral->lines[newest].length;
+        uint32_t revised = 0;
+        for(uint32_t i = newest; i > 0; i--) {
+            if(stats->lengths[i - 1] == spiral->lines[i - 1].length) {
+                break;
             }
-        } else {
-            fprintf(
-                stderr,
-                "Couldn't open file for writing: %s\n",
-                user_data.file_path
-            );
+            stats->lengths[i - 1] = spiral->lines[i - 1].length;
+            revised++;
+        }
+        if(revised > 0) {
+            stats->backtracks++;
+            stats->lines_revised += revised;
+        }
+    }
+    // sample the solve rate
+    double elapsed = now - stats->solve_start;
+    double last_sample = (
+        (stats->sample_count == 0) ? 0.0 :
+        stats->samples[stats->sample_count - 1].seconds
+    );
+    if(elapsed - last_sample >= stats->sample_interval) {
+        if(stats->sample_count == STATS_MAX_SAMPLES) {
+            // thin out the samples so we don't run out of room
+            for(size_t i = 0; i < STATS_MAX_SAMPLES / 2; i++) {
+                stats->samples[i] = stats->samples[i * 2 + 1];
+            }
+            stats->sample_count = STATS_MAX_SAMPLES / 2;
+            stats->sample_interval *= 2.0;
+        }
+        stats->samples[stats->sample_count].seconds = elapsed;
+        stats->samples[stats->sample_count].solved_count = spiral->solved_count;
+        stats->sample_count++;
+    }
+    // print progress if it's time to
+    if((stats->progress_interval > 0.0) && (elapsed >= stats->next_progress)) {
+        uint32_t solved_now = spiral->solved_count - stats->start_solved_count;
+        fprintf(
+            stderr, "Solved %" PRIu32 "/%" PRIu32 " lines (%.1f%%), "
+            "%.1f lines/s, %.0fs elapsed\n",
+            spiral->solved_count, stats->target_line,
+            (stats->target_line > 0) ?
+            100.0 * spiral->solved_count / stats->target_line : 100.0,
+            (elapsed > 0.0) ? solved_now / elapsed : 0.0, elapsed
+        );
+        while(stats->next_progress <= elapsed) {
+            stats->next_progress += stats->progress_interval;
         }
     }
 }
-// re-enable all warnings
-#pragma GCC diagnostic pop
+
+// private function, returns the peak resident set size of the process in KiB
+static long peak_rss_kib(void) {
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef __APPLE__
+    // macOS reports this in bytes rather than kilobytes
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
 
 /*
- * function responsible for actually doing the main work, called by main with
- * options configured via command-line.
+ * private function, writes collected statistics to the file at the given path
+ * as JSON.
  * returns true on success, false on failure.
  */
-static bool run(
-    bool prepare, bool generate, bool render, bool perfect,
-    int perfect_threshold, int line_limit, int total_lines, int save_every,
-    const char* image_format, const char* input_string,
-    const char* input_file_path, const char* output_file_path
+static bool write_run_stats(
+    const struct run_stats_t* stats, bool run_ok, const char* path
 ) {
-    // make input buffer
-    sxbp_buffer_t input_buffer = {0, 0};
-    // make output buffer
-    sxbp_buffer_t output_buffer = {0, 0};
-    // used later for telling if read from input file or string was success
-    bool read_ok = false;
-    // used later for telling if write of output file was success
-    bool write_ok = false;
-    // work out whether we're reading from string or file or if neither were given
-    if((strcmp(input_file_path, "") == 0) && (strcmp(input_string, "") == 0)) {
-        fprintf(stderr, "Neither an input file or an input string were given\n");
+    FILE* stats_file = fopen(path, "w");
+    if(stats_file == NULL) {
         return false;
-    } else if(strcmp(input_file_path, "") == 0) {
-        // the filepath wasn't given so read from string
-        read_ok = string_to_buffer(input_string, &input_buffer);
-    } else {
-        // the string wasn't given so open the file
-        // get input file handle
-        FILE* input_file = fopen(input_file_path, "rb");
-        if(input_file == NULL) {
-            fprintf(stderr, "%s\n", "Couldn't open input file");
-            return false;
-        }
-        // read input file into buffer
-        read_ok = file_to_buffer(input_file, &input_buffer);
-        // close input file
-        fclose(input_file);
-        // if read was unsuccessful, don't continue
     }
-    if(read_ok == false) {
-        fprintf(stderr, "%s\n", "Couldn't read input file/data");
-        return false;
+    fprintf(stats_file, "{\n  \"ok\": %s,\n", run_ok ? "true" : "false");
+    // time spent in each phase
+    fprintf(stats_file, "  \"phases\": {\n");
+    for(size_t i = 0; i < PHASE_COUNT; i++) {
+        fprintf(
+            stats_file,
+            "    \"%s\": {\"wall_seconds\": %.6f, \"cpu_seconds\": %.6f}%s\n",
+            RUN_PHASE_NAMES[i], stats->phases[i].wall_seconds,
+            stats->phases[i].cpu_seconds, (i + 1 < PHASE_COUNT) ? "," : ""
+        );
     }
-    // create initial blank spiral struct
-    sxbp_spiral_t spiral = sxbp_blank_spiral();
-    // resolve perfection threshold - set to -1 if disabled completely
-    int perfection = (perfect == false) ? -1 : perfect_threshold;
-    // check error condition (where no actions were specified)
-    if((prepare || generate || render) == false) {
-        // none of the above. this is an error condition - nothing to be done
-        fprintf(stderr, "%s\n", "Nothing to be done!");
-        return false;
+    fprintf(stats_file, "  },\n");
+    fprintf(stats_file, "  \"peak_rss_kib\": %ld,\n", peak_rss_kib());
+    // buffers the run took from the buffer pool
+    uint64_t allocated = 0;
+    uint64_t reused = 0;
+    buffer_pool_counts(&allocated, &reused);
+    fprintf(
+        stats_file,
+        "  \"buffers\": {\"allocated\": %" PRIu64 ", "
+        "\"reused\": %" PRIu64 "},\n",
+        allocated - stats->buffers_allocated, reused - stats->buffers_reused
+    );
+    if(stats->cache_result != NULL) {
+        fprintf(stats_file, "  \"cache\": \"%s\",\n", stats->cache_result);
     }
-    // PBM format is default for rendering to image
-    enum spiral_render_mode_t default_render_mode = RENDER_MODE_PBM;
-    // override render image format if format option given
-    if(
-        (render == true) &&
-        (image_format != NULL) &&
-        (strcmp(image_format, "") != 0)
-    ) {
-        if(strcmp(image_format, "png") == 0) {
-            // check that PNG support is enabled in libsxbp
-            if(SXBP_PNG_SUPPORT == true) {
-                default_render_mode = RENDER_MODE_PNG;
-            } else {
-                // otheriwse, print an error message and return false
-                fprintf(
-                    stderr,
-                    "The loaded instance of libsxbp has not been "
-                    "compiled with PNG output support.\n"
-                );
-                return false;
-            }
-        } else if(strcmp(image_format, "pbm") == 0) {
-            // No-op as it's already set to PBM format
-            NULL;
-        } else {
-            // Error, unrecognised file format
-            fprintf(
-                stderr, "Unsupported image file format: '%s'\n",
-                image_format
-            );
-            return false;
+    // solver telemetry
+    fprintf(
+        stats_file,
+        "  \"solver\": {\n"
+        "    \"start_solved_count\": %" PRIu32 ",\n"
+        "    \"solved_count\": %" PRIu32 ",\n"
+        "    \"target_line\": %" PRIu32 ",\n"
+        "    \"backtracks\": %" PRIu64 ",\n"
+        "    \"lines_revised\": %" PRIu64 ",\n",
+        stats->start_solved_count, stats->solved_count, stats->target_line,
+        stats->backtracks, stats->lines_revised
+    );
+    // solve rate over time, as the rate since the previous sample
+    fprintf(stats_file, "    \"samples\": [");
+    for(size_t i = 0; i < stats->sample_count; i++) {
+        const struct solve_sample_t* sample = &stats->samples[i];
+        double seconds = sample->seconds;
+        uint32_t solved = sample->solved_count - stats->start_solved_count;
+        if(i > 0) {
+            seconds -= stats->samples[i - 1].seconds;
+            solved = sample->solved_count - stats->samples[i - 1].solved_count;
         }
+        fprintf(
+            stats_file,
+            "%s\n      {\"seconds\": %.3f, \"solved_count\": %" PRIu32
+            ", \"lines_per_second\": %.3f}",
+            (i > 0) ? "," : "", sample->seconds, sample->solved_count,
+            (seconds > 0.0) ? solved / seconds : 0.0
+        );
     }
-    // otherwise, good to go
-    if(prepare) {
-        // we must build spiral from raw file first
-        if(handle_error(sxbp_init_spiral(input_buffer, &spiral))) {
-            // handle errors
-            return false;
-        }
-    } else {
-        // otherwise, we must load spiral from file
-        sxbp_serialise_result_t result = sxbp_load_spiral(input_buffer, &spiral);
-        // if we had problems, print to stderr and quit
-        if(result.status != SXBP_OPERATION_OK) {
-            fprintf(
-                stderr,
-                "Error Code:\t\t%s\nFile Error Code:\t%s\n",
-                error_code_string(result.status),
-                file_error_code_string(result.diagnostic)
-            );
-            return false;
-        }
+    fprintf(stats_file, "%s],\n", (stats->sample_count > 0) ? "\n    " : "");
+    // histogram of time per line, leaving off the empty buckets at the end
+    size_t bucket_count = STATS_HISTOGRAM_BUCKETS;
+    while(
+        (bucket_count > 0) &&
+        (stats->line_time_histogram[bucket_count - 1] == 0)
+    ) {
+        bucket_count--;
     }
-    if(generate) {
-        /*
-         * find out how many lines we are to plot
-         * this is based on two options: the line_limit and the total_lines
-         * arguments.
-         */
-        // first, check the line_limit argument
-        uint32_t lines_to_plot;
-        // set to solved count + line limit if set, else spiral size
-        lines_to_plot = (
-            (line_limit != -1) ? (spiral.solved_count + line_limit) : spiral.size
-        );
-        // set to total_lines if set and less than current amount
-        lines_to_plot = (
-            (total_lines != -1 && (uint32_t)total_lines < lines_to_plot) ?
-            (uint32_t)total_lines : lines_to_plot
+    fprintf(stats_file, "    \"line_time_histogram\": [");
+    for(size_t i = 0; i < bucket_count; i++) {
+        fprintf(
+            stats_file,
+            "%s\n      {\"min_microseconds\": %" PRIu64
+            ", \"max_microseconds\": %" PRIu64 ", \"lines\": %" PRIu64 "}",
+            (i > 0) ? "," : "", (i == 0) ? (uint64_t)0 : (uint64_t)1 << i,
+            (uint64_t)1 << (i + 1), stats->line_time_histogram[i]
         );
-        // we must plot the unsolved lines from spiral file
-        sxbp_status_t errors;
-        if(save_every > 0) {
-            // if we've been asked to save every x lines, we need to use callback
-            // build user data for callback
-            struct user_data_t user_data = {
-                // use default image format if rendering to image
-                .render_mode = (
-                    (render == false) ? RENDER_MODE_SXP : default_render_mode
-                ),
-                .file_path = output_file_path,
-                .save_line_interval = save_every,
-            };
-            errors = sxbp_plot_spiral(
-                &spiral, perfection, lines_to_plot,
-                plot_spiral_callback, (void*)&user_data
-            );
-        } else {
-            // otherwise, no need to use callback
-            errors = sxbp_plot_spiral(
-                &spiral, perfection, lines_to_plot, NULL, NULL
-            );
-        }
-        // handle errors
-        if(handle_error(errors)) {
-            // handle errors
-            return false;
-        }
     }
-    if(render) {
-        /*
-         * render spiral to image, using PBM render function and store
-         * data in buffer - handle error if any
-         */
-        sxbp_status_t error = SXBP_STATE_UNKNOWN;
-        // render to whichever image format was specified
-        if(default_render_mode == RENDER_MODE_PBM) {
-            // render to PBM format
-            error = sxbp_render_spiral_image(
-                spiral, &output_buffer, sxbp_render_backend_pbm
-            );
-        } else if(default_render_mode == RENDER_MODE_PNG) {
-            // render to PNG format
-            error = sxbp_render_spiral_image(
-                spiral, &output_buffer, sxbp_render_backend_png
-            );
+    fprintf(stats_file, "%s]\n  }\n}\n", (bucket_count > 0) ? "\n    " : "");
+    return fclose(stats_file) == 0;
+}
+
+/*
+ * private function, returns the CRC-32 checksum of the given bytes following
+ * on from those the given checksum is of.
+ * zlib's crc32() only takes so many bytes at once, so it's fed in chunks.
+ */
+static uint32_t update_checksum(
+    uint32_t crc, const uint8_t* bytes, size_t size
+) {
+    uLong result = crc;
+    while(size > 0) {
+        uInt chunk = (size > UINT_MAX) ? UINT_MAX : (uInt)size;
+        result = crc32(result, bytes, chunk);
+        bytes += chunk;
+        size -= chunk;
+    }
+    return (uint32_t)result;
+}
+
+// private function, returns the CRC-32 checksum of the given bytes
+static uint32_t checksum(const uint8_t* bytes, size_t size) {
+    return update_checksum(0, bytes, size);
+}
+
+// private function, writes the given value to bytes as big-endian
+static void store_uint32(uint8_t* bytes, uint32_t value) {
+    for(size_t i = 0; i < 4; i++) {
+        bytes[i] = (uint8_t)(value >> (8 * (3 - i)));
+    }
+}
+
+// private function, reads a big-endian value from bytes
+static uint32_t load_uint32(const uint8_t* bytes) {
+    uint32_t value = 0;
+    for(size_t i = 0; i < 4; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+// private function, packs a line into 32 bits: 2 of direction, 30 of length
+static uint32_t pack_line(sxbp_line_t line) {
+    return (
+        ((uint32_t)line.direction << 30) |
+        ((uint32_t)line.length & 0x3fffffffu)
+    );
+}
+
+/*
+ * disable GCC warning about conversion to the line's bit-fields, the masks make
+ * sure the values fit
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+// private function, unpacks a line packed by pack_line()
+static sxbp_line_t unpack_line(uint32_t packed) {
+    sxbp_line_t line;
+    line.direction = (packed >> 30) & 0x3u;
+    line.length = packed & 0x3fffffffu;
+    return line;
+}
+// re-enable all warnings
+#pragma GCC diagnostic pop
+
+// private function, adds the given bytes to a 64-bit FNV-1a hash
+static uint64_t fnv1a_64(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3u;
+    }
+    return hash;
+}
+
+/*
+ * private structure, the smallest box holding all of the co-ords of a spiral's
+ * solved lines, with the spiral starting at 0, 0
+ */
+struct spiral_bounds_t {
+    int64_t min_x, max_x, min_y, max_y;
+};
+
+// private function, finds the bounds of the solved lines of the given spiral
+static struct spiral_bounds_t find_spiral_bounds(const sxbp_spiral_t* spiral) {
+    struct spiral_bounds_t bounds = {0, 0, 0, 0};
+    int64_t x = 0, y = 0;
+    for(uint32_t i = 0; i < spiral->solved_count; i++) {
+        sxbp_vector_t vector = (
+            SXBP_VECTOR_DIRECTIONS[spiral->lines[i].direction]
+        );
+        x += vector.x * spiral->lines[i].length;
+        y += vector.y * spiral->lines[i].length;
+        bounds.min_x = (x < bounds.min_x) ? x : bounds.min_x;
+        bounds.max_x = (x > bounds.max_x) ? x : bounds.max_x;
+        bounds.min_y = (y < bounds.min_y) ? y : bounds.min_y;
+        bounds.max_y = (y > bounds.max_y) ? y : bounds.max_y;
+    }
+    return bounds;
+}
+
+// private function, stores a signed 64-bit number big-endian
+static void store_int64(uint8_t* bytes, int64_t value) {
+    store_uint32(bytes, (uint32_t)((uint64_t)value >> 32));
+    store_uint32(bytes + 4, (uint32_t)(uint64_t)value);
+}
+
+// private function, loads a signed 64-bit number stored by store_int64()
+static int64_t load_int64(const uint8_t* bytes) {
+    return (int64_t)(
+        ((uint64_t)load_uint32(bytes) << 32) | load_uint32(bytes + 4)
+    );
+}
+
+/*
+ * private structure, what's worked out from the solved lines of a spiral as
+ * it's generated and rendered, bar libsxbp's co-ord cache and collision state,
+ * which are kept in the spiral itself. v2 sxp files can store all of it, so
+ * that loading one doesn't have to work it out again.
+ */
+struct spiral_geometry_t {
+    bool store; // whether to store it in the v2 sxp files written
+    bool known; // whether the bounds are known, rather than to be worked out
+    struct spiral_bounds_t bounds; // bounds of the solved lines
+};
+
+/*
+ * private function, returns the bounds of the solved lines of the given
+ * spiral, from its geometry if they're known (geometry may be NULL)
+ */
+static struct spiral_bounds_t spiral_bounds(
+    const sxbp_spiral_t* spiral, const struct spiral_geometry_t* geometry
+) {
+    if((geometry != NULL) && geometry->known) {
+        return geometry->bounds;
+    }
+    return find_spiral_bounds(spiral);
+}
+
+/*
+ * private function, works out the hash stored geometry is checked against: a
+ * 64-bit FNV-1a hash of the spiral's solved lines and the version of libsxbp,
+ * as another version's co-ord cache may be laid out differently
+ */
+static uint64_t solved_lines_hash(const sxbp_spiral_t* spiral) {
+    uint64_t hash = 0xcbf29ce484222325u;
+    hash = fnv1a_64(
+        hash, LIB_SXBP_VERSION.string, strlen(LIB_SXBP_VERSION.string) + 1
+    );
+    uint8_t bytes[4];
+    store_uint32(bytes, spiral->solved_count);
+    hash = fnv1a_64(hash, bytes, sizeof(bytes));
+    for(uint32_t i = 0; i < spiral->solved_count; i++) {
+        store_uint32(bytes, pack_line(spiral->lines[i]));
+        hash = fnv1a_64(hash, bytes, sizeof(bytes));
+    }
+    return hash;
+}
+
+// private structure, the geometry section of a v2 sxp file, as loaded
+struct stored_geometry_t {
+    struct spiral_bounds_t bounds; // bounds of the solved lines
+    bool collides; // libsxbp's collision state
+    uint32_t collider; // line the newest one collides with, if it does
+    uint32_t validity; // number of lines the co-ord cache is valid for
+    uint64_t co_ord_count; // number of co-ords in the cache, 0 if not stored
+};
+
+/*
+ * private function, returns whether geometry loaded from a file fits the given
+ * spiral's solved lines, which it must before any of it is used: the bounds
+ * must be theirs, the collider one of the spiral's lines, and the co-ord cache
+ * valid for no more than the solved lines and laid out as libsxbp lays it out,
+ * with a co-ord for the origin and one for each unit of the lines it's valid
+ * for. checking it walks the solved lines, as hashing them already has to.
+ */
+static bool stored_geometry_fits(
+    const sxbp_spiral_t* spiral, const struct stored_geometry_t* stored
+) {
+    if(
+        (
+            (stored->collider >= spiral->size) &&
+            (stored->collides || (stored->collider != 0))
+        ) ||
+        (
+            (stored->co_ord_count > 0) &&
+            (stored->validity > spiral->solved_count)
+        )
+    ) {
+        return false;
+    }
+    struct spiral_bounds_t bounds = find_spiral_bounds(spiral);
+    if(
+        (bounds.min_x != stored->bounds.min_x) ||
+        (bounds.max_x != stored->bounds.max_x) ||
+        (bounds.min_y != stored->bounds.min_y) ||
+        (bounds.max_y != stored->bounds.max_y)
+    ) {
+        return false;
+    }
+    if(stored->co_ord_count == 0) {
+        return true;
+    }
+    uint64_t co_ords_needed = 1;
+    for(uint32_t i = 0; i < stored->validity; i++) {
+        co_ords_needed += spiral->lines[i].length;
+    }
+    return stored->co_ord_count == co_ords_needed;
+}
+
+/*
+ * the v2 sxp format, which holds the same spiral as libsxbp's own (v1) format
+ * in much less space, and loads faster. all numbers are big-endian:
+ *
+ * - header: magic number, flags, number of lines, number of lines solved,
+ *   number of lines per block and the CRC-32 of the header and index, each of
+ *   32 bits bar the magic number
+ * - index: for each block of lines, its 64-bit offset in the file, its size
+ *   and the CRC-32 of it, 32 bits each
+ * - schedule, only if the schedule flag is set: its 32-bit length, then the
+ *   perfection schedule the lines were solved with as text, as --schedule
+ *   takes it. it comes before the blocks so the header CRC covers it too.
+ * - geometry, only if the geometry flag is set: a 64-bit hash of the solved
+ *   lines it was worked out from (see solved_lines_hash()), their bounds as
+ *   four signed 64-bit numbers (least and most x, then least and most y),
+ *   whether the last line plotted collided and the line it collided with (32
+ *   bits each), then libsxbp's co-ord cache: the number of lines it's valid
+ *   for (32 bits), the number of co-ords in it (64 bits), then each co-ord as
+ *   two signed 64-bit numbers. it comes before the blocks too.
+ * - blocks: the directions of the block's lines packed four to a byte, first
+ *   line in the top bits, then their lengths as LEB128 varints, which are
+ *   mostly one byte each. if the compressed flag is set, each block is
+ *   deflated on top of that.
+ *
+ * blocks don't depend on each other, so the index lets a reader go straight to
+ * the block the solved lines end in, or stop there.
+ */
+#define SXP_V2_MAGIC "SXBPv2\r\n"
+// size of the magic number
+#define SXP_V2_MAGIC_SIZE 8
+// size of the header
+#define SXP_V2_HEADER_SIZE (SXP_V2_MAGIC_SIZE + 20)
+// size of each entry in the index
+#define SXP_V2_INDEX_ENTRY_SIZE 16
+// number of lines in each block, bar the last which may have fewer
+#define SXP_V2_BLOCK_LINES 65536
+// flag for whether blocks are deflated
+#define SXP_V2_COMPRESSED 0x1u
+// flag for whether a perfection schedule follows the index
+#define SXP_V2_SCHEDULE 0x2u
+// flag for whether the spiral's geometry follows the index and any schedule
+#define SXP_V2_GEOMETRY 0x4u
+// size of the geometry before its co-ords
+#define SXP_V2_GEOMETRY_SIZE 60
+// size of each co-ord of the geometry
+#define SXP_V2_CO_ORD_SIZE 16
+// most bytes one line's length can take up as a varint
+#define SXP_V2_MAX_VARINT_SIZE 5
+
+// private function, returns the number of bytes a line length takes up
+static size_t varint_size(uint32_t value) {
+    size_t size = 1;
+    while(value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+/*
+ * private function, returns the number of bytes the given lines of a spiral
+ * take up in a v2 block before any compression
+ */
+static size_t sxp_v2_block_size(
+    const sxbp_spiral_t* spiral, uint32_t start, uint32_t count
+) {
+    size_t size = ((size_t)count + 3) / 4;
+    for(uint32_t i = start; i < start + count; i++) {
+        size += varint_size(spiral->lines[i].length);
+    }
+    return size;
+}
+
+// private function, encodes the given lines of a spiral as a v2 block
+static void encode_sxp_v2_block(
+    const sxbp_spiral_t* spiral, uint32_t start, uint32_t count, uint8_t* bytes
+) {
+    size_t direction_size = ((size_t)count + 3) / 4;
+    memset(bytes, 0, direction_size);
+    for(uint32_t i = 0; i < count; i++) {
+        bytes[i / 4] |= (uint8_t)(
+            spiral->lines[start + i].direction << (6 - 2 * (i % 4))
+        );
+    }
+    uint8_t* cursor = bytes + direction_size;
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t length = spiral->lines[start + i].length;
+        while(length >= 0x80) {
+            *cursor++ = (uint8_t)(length | 0x80);
+            length >>= 7;
         }
-        // handle errors
-        if(handle_error(error)) {
-            return false;
+        *cursor++ = (uint8_t)length;
+    }
+}
+
+/*
+ * private function, decodes a v2 block into the given lines of a spiral.
+ * returns true on success, false if the block is malformed.
+ */
+static bool decode_sxp_v2_block(
+    const uint8_t* bytes, size_t size, sxbp_spiral_t* spiral, uint32_t start,
+    uint32_t count
+) {
+    size_t direction_size = ((size_t)count + 3) / 4;
+    if(size < direction_size) {
+        return false;
+    }
+    const uint8_t* cursor = bytes + direction_size;
+    const uint8_t* end = bytes + size;
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t length = 0;
+        for(unsigned int shift = 0; ; shift += 7) {
+            if((cursor == end) || (shift >= 7 * SXP_V2_MAX_VARINT_SIZE)) {
+                return false;
+            }
+            uint8_t byte = *cursor++;
+            length |= (uint32_t)(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                break;
+            }
         }
-    } else {
-        // otherwise, we must simply dump the spiral as-is
-        sxbp_serialise_result_t result = sxbp_dump_spiral(spiral, &output_buffer);
-        // if we had problems, print to stderr and quit
-        if(result.status != SXBP_OPERATION_OK) {
-            fprintf(
-                stderr,
-                "Error Code:\t\t%s\nFile Error Code:\t%s\n",
-                error_code_string(result.status),
-                file_error_code_string(result.diagnostic)
-            );
+        // lengths are only 30 bits
+        if(length > 0x3fffffffu) {
             return false;
         }
+        uint32_t direction = (bytes[i / 4] >> (6 - 2 * (i % 4))) & 0x3u;
+        spiral->lines[start + i] = unpack_line((direction << 30) | length);
     }
-    // get output file handle
-    FILE* output_file = fopen(output_file_path, "wb");
-    if(output_file == NULL) {
-        fprintf(stderr, "%s\n", "Couldn't open output file");
-        return false;
-    }
-    // now, write output buffer to file
-    write_ok = buffer_to_file(&output_buffer, output_file);
-    // close output file
-    fclose(output_file);
-    // free buffers
-    free(input_buffer.bytes);
-    free(output_buffer.bytes);
-    // return success depends on last write
-    return write_ok;
+    // there mustn't be anything left over
+    return cursor == end;
 }
 
-// main - mostly just process arguments, the bulk of the work is done by run()
-int main(int argc, char* argv[]) {
-    // status code initially set to -1
-    int status_code = -1;
-    // build argtable struct for parsing command-line arguments
-    // show help
-    struct arg_lit* help = arg_lit0("h","help", "show this help and exit");
-    // show version
-    struct arg_lit* version = arg_lit0(
-        "v", "version", "show version of program and library, then exit"
-    );
-    // flag for if we want to prepare a spiral
-    struct arg_lit* prepare = arg_lit0(
-        "p", "prepare",
-        "prepare a spiral from raw binary data"
-    );
-    // flag for if we want to generate the solution for a spiral's line lengths
-    struct arg_lit* generate = arg_lit0(
-        "g", "generate",
-        "generate the lengths of a spiral's lines"
+/*
+ * private function, serialises a spiral in the v2 sxp format, deflating each
+ * block if compressed is true, and recording the given perfection schedule
+ * with it if that's not NULL. its geometry is stored too if the given geometry
+ * isn't NULL and says to. libsxbp's co-ord cache is only stored if it's valid
+ * for no more than the solved lines, which are all the hash covers.
+ * the buffer comes from the buffer pool, capacity is set to what it must be
+ * given back to release_buffer() with.
+ * returns true on success, false if memory couldn't be allocated.
+ */
+static bool dump_spiral_v2(
+    const sxbp_spiral_t* spiral, bool compressed, const char* schedule,
+    const struct spiral_geometry_t* geometry, sxbp_buffer_t* buffer,
+    size_t* capacity
+) {
+    buffer->bytes = NULL;
+    buffer->size = 0;
+    *capacity = 0;
+    size_t block_count = (
+        ((size_t)spiral->size + SXP_V2_BLOCK_LINES - 1) / SXP_V2_BLOCK_LINES
     );
-    // flag for if we want to render a spiral to imagee
-    struct arg_lit* render = arg_lit0(
-        "r", "render", "render a spiral to an image"
+    size_t index_end = (
+        SXP_V2_HEADER_SIZE + block_count * SXP_V2_INDEX_ENTRY_SIZE
     );
-    // input file path option
-    struct arg_file* input = arg_file0(
-        "i", "input", NULL, "input file path"
+    size_t schedule_size = (schedule != NULL) ? strlen(schedule) : 0;
+    size_t geometry_start = (
+        index_end + ((schedule != NULL) ? 4 + schedule_size : 0)
     );
-    // output file path option
-    struct arg_file* output = arg_file0(
-        "o", "output", NULL, "output file path"
+    bool store_geometry = (geometry != NULL) && geometry->store;
+    size_t co_ord_count = 0;
+    if(
+        store_geometry &&
+        (spiral->co_ord_cache.validity <= spiral->solved_count) &&
+        (spiral->co_ord_cache.co_ords.items != NULL)
+    ) {
+        co_ord_count = spiral->co_ord_cache.co_ords.size;
+    }
+    size_t data_start = geometry_start + (
+        store_geometry ?
+        SXP_V2_GEOMETRY_SIZE + co_ord_count * SXP_V2_CO_ORD_SIZE : 0
     );
-    struct arg_str* image_format = arg_str0(
-        "f", "image-format", "FORMAT",
-        "which image format to render to (pbm/png)"
+    // work out the most room the blocks can need, so it's all allocated once
+    size_t needed = data_start;
+    size_t largest_block = 0;
+    for(size_t b = 0; b < block_count; b++) {
+        uint32_t start = (uint32_t)(b * SXP_V2_BLOCK_LINES);
+        uint32_t count = spiral->size - start;
+        count = (count > SXP_V2_BLOCK_LINES) ? SXP_V2_BLOCK_LINES : count;
+        size_t size = sxp_v2_block_size(spiral, start, count);
+        largest_block = (size > largest_block) ? size : largest_block;
+        needed += compressed ? compressBound((uLong)size) : size;
+    }
+    size_t bytes_capacity = 0;
+    size_t scratch_capacity = 0;
+    uint8_t* bytes = acquire_buffer(needed, &bytes_capacity);
+    uint8_t* scratch = (
+        compressed ? acquire_buffer(largest_block + 1, &scratch_capacity) : NULL
     );
-    struct arg_int* save_every = arg_int0(
-        "s", "save-every", NULL,
-        "save to file every this number of lines solved"
+    if((bytes == NULL) || (compressed && (scratch == NULL))) {
+        release_buffer(bytes, bytes_capacity);
+        release_buffer(scratch, scratch_capacity);
+        return false;
+    }
+    memcpy(bytes, SXP_V2_MAGIC, SXP_V2_MAGIC_SIZE);
+    store_uint32(
+        bytes + 8,
+        (compressed ? SXP_V2_COMPRESSED : 0) |
+        ((schedule != NULL) ? SXP_V2_SCHEDULE : 0) |
+        (store_geometry ? SXP_V2_GEOMETRY : 0)
     );
-    struct arg_str* input_string = arg_str0(
-        "S", "string", "STRING",
-        "use the given STRING as input data for the spiral"
+    store_uint32(bytes + 12, spiral->size);
+    store_uint32(bytes + 16, spiral->solved_count);
+    store_uint32(bytes + 20, SXP_V2_BLOCK_LINES);
+    if(schedule != NULL) {
+        store_uint32(bytes + index_end, (uint32_t)schedule_size);
+        memcpy(bytes + index_end + 4, schedule, schedule_size);
+    }
+    if(store_geometry) {
+        uint8_t* cursor = bytes + geometry_start;
+        uint64_t hash = solved_lines_hash(spiral);
+        store_uint32(cursor, (uint32_t)(hash >> 32));
+        store_uint32(cursor + 4, (uint32_t)hash);
+        struct spiral_bounds_t bounds = spiral_bounds(spiral, geometry);
+        store_int64(cursor + 8, bounds.min_x);
+        store_int64(cursor + 16, bounds.max_x);
+        store_int64(cursor + 24, bounds.min_y);
+        store_int64(cursor + 32, bounds.max_y);
+        store_uint32(cursor + 40, spiral->collides ? 1 : 0);
+        store_uint32(cursor + 44, spiral->collider);
+        store_uint32(
+            cursor + 48, (co_ord_count > 0) ? spiral->co_ord_cache.validity : 0
+        );
+        store_uint32(cursor + 52, (uint32_t)((uint64_t)co_ord_count >> 32));
+        store_uint32(cursor + 56, (uint32_t)co_ord_count);
+        cursor += SXP_V2_GEOMETRY_SIZE;
+        for(size_t i = 0; i < co_ord_count; i++) {
+            store_int64(cursor, spiral->co_ord_cache.co_ords.items[i].x);
+            store_int64(cursor + 8, spiral->co_ord_cache.co_ords.items[i].y);
+            cursor += SXP_V2_CO_ORD_SIZE;
+        }
+    }
+    size_t offset = data_start;
+    bool ok = true;
+    for(size_t b = 0; ok && (b < block_count); b++) {
+        uint32_t start = (uint32_t)(b * SXP_V2_BLOCK_LINES);
+        uint32_t count = spiral->size - start;
+        count = (count > SXP_V2_BLOCK_LINES) ? SXP_V2_BLOCK_LINES : count;
+        size_t size = sxp_v2_block_size(spiral, start, count);
+        if(compressed) {
+            // speed matters more than the last few bytes here
+            encode_sxp_v2_block(spiral, start, count, scratch);
+            uLongf compressed_size = (uLongf)(needed - offset);
+            ok = (
+                compress2(
+                    bytes + offset, &compressed_size, scratch, (uLong)size,
+                    Z_BEST_SPEED
+                ) == Z_OK
+            );
+            size = (size_t)compressed_size;
+        } else {
+            encode_sxp_v2_block(spiral, start, count, bytes + offset);
+        }
+        uint8_t* entry = (
+            bytes + SXP_V2_HEADER_SIZE + b * SXP_V2_INDEX_ENTRY_SIZE
+        );
+        store_uint32(entry, (uint32_t)((uint64_t)offset >> 32));
+        store_uint32(entry + 4, (uint32_t)offset);
+        store_uint32(entry + 8, (uint32_t)size);
+        store_uint32(entry + 12, checksum(bytes + offset, size));
+        offset += size;
+    }
+    release_buffer(scratch, scratch_capacity);
+    if(!ok) {
+        release_buffer(bytes, bytes_capacity);
+        return false;
+    }
+    /*
+     * the checksum covers the header up to itself, then the index, schedule
+     * and geometry after it
+     */
+    store_uint32(
+        bytes + 24,
+        update_checksum(
+            checksum(bytes, 24), bytes + SXP_V2_HEADER_SIZE,
+            data_start - SXP_V2_HEADER_SIZE
+        )
     );
-    struct arg_int* perfect_threshold = arg_int0(
-        "d", "perfection-threshold", NULL, "set optimisation threshold"
+    // what compression saved isn't given back, the pool reuses it all anyway
+    buffer->bytes = bytes;
+    buffer->size = offset;
+    *capacity = bytes_capacity;
+    return true;
+}
+
+/*
+ * private function, loads a spiral serialised in the v2 sxp format. if
+ * solved_only is true, blocks after the one the solved lines end in aren't
+ * decoded and their lines are left blank, which is all rendering needs.
+ * if schedule isn't NULL, it's set to a copy of the perfection schedule
+ * recorded in the file, or NULL if there isn't one. if geometry isn't NULL
+ * and the file's geometry matches its solved lines, it's loaded into geometry
+ * and the spiral, skipping the co-ord cache if solved_only is true as only
+ * generating uses it. otherwise geometry is left unknown.
+ * problems with the file are reported with the closest of libsxbp's own
+ * diagnostics: damaged or inconsistent data is reported as a bad data size.
+ * returns the status and diagnostic as sxbp_load_spiral() does.
+ */
+static sxbp_serialise_result_t load_spiral_v2(
+    sxbp_buffer_t buffer, sxbp_spiral_t* spiral, bool solved_only,
+    char** schedule, struct spiral_geometry_t* geometry
+) {
+    if(schedule != NULL) {
+        *schedule = NULL;
+    }
+    if(geometry != NULL) {
+        geometry->known = false;
+    }
+    sxbp_serialise_result_t result = {
+        SXBP_OPERATION_FAIL, SXBP_DESERIALISE_OK,
+    };
+    if(buffer.size < SXP_V2_HEADER_SIZE) {
+        result.diagnostic = SXBP_DESERIALISE_BAD_HEADER_SIZE;
+        return result;
+    } else if(memcmp(buffer.bytes, SXP_V2_MAGIC, SXP_V2_MAGIC_SIZE) != 0) {
+        result.diagnostic = SXBP_DESERIALISE_BAD_MAGIC_NUMBER;
+        return result;
+    }
+    // flags we don't know about mean it's from a newer version than this
+    uint32_t flags = load_uint32(buffer.bytes + 8);
+    if(
+        (flags & ~(SXP_V2_COMPRESSED | SXP_V2_SCHEDULE | SXP_V2_GEOMETRY)) != 0
+    ) {
+        result.diagnostic = SXBP_DESERIALISE_BAD_VERSION;
+        return result;
+    }
+    bool compressed = (flags & SXP_V2_COMPRESSED) != 0;
+    uint32_t size = load_uint32(buffer.bytes + 12);
+    uint32_t solved_count = load_uint32(buffer.bytes + 16);
+    uint32_t block_lines = load_uint32(buffer.bytes + 20);
+    size_t block_count = (
+        (block_lines == 0) ? 0 :
+        ((size_t)size + block_lines - 1) / block_lines
     );
-    struct arg_lit* perfect = arg_lit0(
-        "D", "disable-perfection", "allow unlimited optimisations"
+    size_t index_end = (
+        SXP_V2_HEADER_SIZE + block_count * SXP_V2_INDEX_ENTRY_SIZE
     );
-    struct arg_int* line_limit = arg_int0(
-        "l", "line-limit", NULL,
-        "plot this many more lines than currently solved"
+    size_t data_start = index_end;
+    size_t schedule_size = 0;
+    result.diagnostic = SXBP_DESERIALISE_BAD_DATA_SIZE;
+    if((flags & SXP_V2_SCHEDULE) != 0) {
+        if(buffer.size < index_end + 4) {
+            return result;
+        }
+        schedule_size = load_uint32(buffer.bytes + index_end);
+        data_start = index_end + 4 + schedule_size;
+    }
+    size_t geometry_start = data_start;
+    uint64_t co_ord_count = 0;
+    if((flags & SXP_V2_GEOMETRY) != 0) {
+        if(
+            (geometry_start < index_end) ||
+            (buffer.size < SXP_V2_GEOMETRY_SIZE) ||
+            (geometry_start > buffer.size - SXP_V2_GEOMETRY_SIZE)
+        ) {
+            return result;
+        }
+        const uint8_t* counts = buffer.bytes + geometry_start + 52;
+        co_ord_count = (
+            ((uint64_t)load_uint32(counts) << 32) | load_uint32(counts + 4)
+        );
+        size_t room = buffer.size - geometry_start - SXP_V2_GEOMETRY_SIZE;
+        if(co_ord_count > room / SXP_V2_CO_ORD_SIZE) {
+            return result;
+        }
+        data_start = (
+            geometry_start + SXP_V2_GEOMETRY_SIZE +
+            (size_t)co_ord_count * SXP_V2_CO_ORD_SIZE
+        );
+    }
+    if(
+        (block_lines == 0) || (block_lines > SXP_V2_BLOCK_LINES) ||
+        (solved_count > size) || (data_start < index_end) ||
+        (buffer.size < data_start) ||
+        (
+            update_checksum(
+                checksum(buffer.bytes, 24), buffer.bytes + SXP_V2_HEADER_SIZE,
+                data_start - SXP_V2_HEADER_SIZE
+            ) != load_uint32(buffer.bytes + 24)
+        )
+    ) {
+        return result;
+    }
+    spiral->lines = calloc((size > 0) ? size : 1, sizeof(sxbp_line_t));
+    // compressed blocks are inflated into here before being decoded
+    size_t scratch_size = (
+        ((size_t)block_lines + 3) / 4 +
+        (size_t)block_lines * SXP_V2_MAX_VARINT_SIZE
     );
-    struct arg_int* total_lines = arg_int0(
-        "t", "total-lines", NULL, "total number of lines to plot to"
+    size_t scratch_capacity = 0;
+    uint8_t* scratch = (
+        compressed ? acquire_buffer(scratch_size, &scratch_capacity) : NULL
     );
-    // argtable boilerplate
-    struct arg_end* end = arg_end(20);
-    void* argtable[] = {
-        help, version,
-        prepare, generate, render, input, output, image_format,
-        save_every, input_string,
-        perfect_threshold, perfect, line_limit, total_lines, end,
-    };
-    const char* program_name = "sxbp";
-    // check argtable members were allocated successfully
-    if(arg_nullcheck(argtable) != 0) {
-        // NULL entries were detected, so some allocations failed
-        fprintf(
-            stderr, "%s\n", "FATAL: Could not allocate all entries for argtable"
-        );
-        status_code = 2;
+    if((spiral->lines == NULL) || (compressed && (scratch == NULL))) {
+        free(spiral->lines);
+        release_buffer(scratch, scratch_capacity);
+        spiral->lines = NULL;
+        result.status = SXBP_MALLOC_REFUSED;
+        result.diagnostic = SXBP_DESERIALISE_OK;
+        return result;
     }
-    // set default value of perfect_threshold argument
-    perfect_threshold->ival[0] = 1;
-    // set default value of line_limit, total_lines and save_every arguments
-    line_limit->ival[0] = -1;
-    total_lines->ival[0] = -1;
-    save_every->ival[0] = -1;
-    // parse arguments
-    int count_errors = arg_parse(argc, argv, argtable);
-    // if we asked for the version, show it
-    if(version->count > 0) {
-        printf(
-            "%s %s (using libsxbp %s)\n",
-            program_name, SXBP_VERSION_STRING, LIB_SXBP_VERSION.string
+    spiral->size = size;
+    spiral->solved_count = solved_count;
+    bool ok = true;
+    for(size_t b = 0; ok && (b < block_count); b++) {
+        uint32_t start = (uint32_t)(b * block_lines);
+        if(solved_only && (start >= solved_count)) {
+            break;
+        }
+        uint32_t count = size - start;
+        count = (count > block_lines) ? block_lines : count;
+        const uint8_t* entry = (
+            buffer.bytes + SXP_V2_HEADER_SIZE + b * SXP_V2_INDEX_ENTRY_SIZE
+        );
+        uint64_t offset = (
+            ((uint64_t)load_uint32(entry) << 32) | load_uint32(entry + 4)
+        );
+        size_t stored_size = load_uint32(entry + 8);
+        ok = (
+            (offset >= data_start) && (offset <= buffer.size) &&
+            (stored_size <= buffer.size - offset)
+        );
+        const uint8_t* block = ok ? buffer.bytes + offset : NULL;
+        ok = ok && (checksum(block, stored_size) == load_uint32(entry + 12));
+        if(ok && compressed) {
+            uLongf inflated_size = (uLongf)scratch_size;
+            ok = (
+                uncompress(
+                    scratch, &inflated_size, block, (uLong)stored_size
+                ) == Z_OK
+            );
+            block = scratch;
+            stored_size = (size_t)inflated_size;
+        }
+        ok = ok && decode_sxp_v2_block(
+            block, stored_size, spiral, start, count
         );
-        status_code = 0;
     }
-    // if parser returned any errors, display them and set return code to 1
-    if(count_errors > 0) {
-        arg_print_errors(stderr, end, program_name);
-        status_code = 1;
+    release_buffer(scratch, scratch_capacity);
+    if(!ok) {
+        free(spiral->lines);
+        spiral->lines = NULL;
+        spiral->size = 0;
+        spiral->solved_count = 0;
+        return result;
     }
-    // set return code to 0 if we asked for help
-    if(help->count > 0) {
-        status_code = 0;
+    if((schedule != NULL) && ((flags & SXP_V2_SCHEDULE) != 0)) {
+        *schedule = malloc(schedule_size + 1);
+        if(*schedule == NULL) {
+            free(spiral->lines);
+            spiral->lines = NULL;
+            spiral->size = 0;
+            spiral->solved_count = 0;
+            result.status = SXBP_MALLOC_REFUSED;
+            result.diagnostic = SXBP_DESERIALISE_OK;
+            return result;
+        }
+        memcpy(*schedule, buffer.bytes + index_end + 4, schedule_size);
+        (*schedule)[schedule_size] = '\0';
     }
-    // display usage information if we asked for help or got arguments wrong
-    if((count_errors > 0) || (help->count > 0)) {
-        printf("Usage: %s", program_name);
-        arg_print_syntax(stdout, argtable, "\n");
-        arg_print_glossary(stdout, argtable, "  %-32s %s\n");
+    /*
+     * geometry of other lines than these is no use, and geometry that doesn't
+     * fit them would send libsxbp and the renderers out of bounds, so either
+     * is quietly ignored
+     */
+    const uint8_t* stored = buffer.bytes + geometry_start;
+    struct stored_geometry_t loaded = {
+        .bounds = {
+            load_int64(stored + 8), load_int64(stored + 16),
+            load_int64(stored + 24), load_int64(stored + 32),
+        },
+        .collides = (load_uint32(stored + 40) != 0),
+        .collider = load_uint32(stored + 44),
+        .validity = load_uint32(stored + 48),
+        .co_ord_count = co_ord_count,
+    };
+    if(
+        (geometry != NULL) && ((flags & SXP_V2_GEOMETRY) != 0) &&
+        (solved_lines_hash(spiral) == (
+            ((uint64_t)load_uint32(stored) << 32) | load_uint32(stored + 4)
+        )) &&
+        stored_geometry_fits(spiral, &loaded)
+    ) {
+        geometry->known = true;
+        geometry->bounds = loaded.bounds;
+        spiral->collides = loaded.collides;
+        spiral->collider = loaded.collider;
+        sxbp_co_ord_t* co_ords = NULL;
+        if(!solved_only && (co_ord_count > 0)) {
+            co_ords = malloc((size_t)co_ord_count * sizeof(sxbp_co_ord_t));
+        }
+        // without the cache, libsxbp just works it out again
+        if(co_ords != NULL) {
+            const uint8_t* cursor = stored + SXP_V2_GEOMETRY_SIZE;
+            for(size_t i = 0; i < (size_t)co_ord_count; i++) {
+                co_ords[i].x = load_int64(cursor);
+                co_ords[i].y = load_int64(cursor + 8);
+                cursor += SXP_V2_CO_ORD_SIZE;
+            }
+            free(spiral->co_ord_cache.co_ords.items);
+            spiral->co_ord_cache.co_ords.items = co_ords;
+            spiral->co_ord_cache.co_ords.size = (size_t)co_ord_count;
+            spiral->co_ord_cache.validity = loaded.validity;
+        }
     }
-    // if at this point status_code is not -1, clean up then return early
-    if(status_code != -1) {
-        arg_freetable(argtable, sizeof(argtable) / sizeof(argtable[0]));
-        return status_code;
+    result.status = SXBP_OPERATION_OK;
+    result.diagnostic = SXBP_DESERIALISE_OK;
+    return result;
+}
+
+/*
+ * private function, loads a spiral serialised in either the v1 or v2 sxp
+ * format, telling which by the magic number. if solved_only is true, lines
+ * after those solved may be left blank. if schedule isn't NULL, it's set to
+ * the perfection schedule recorded with the spiral or NULL, and if geometry
+ * isn't NULL it's loaded as in load_spiral_v2() (v1 files never have either).
+ * returns the status and diagnostic as sxbp_load_spiral() does.
+ */
+static sxbp_serialise_result_t load_spiral(
+    sxbp_buffer_t buffer, sxbp_spiral_t* spiral, bool solved_only,
+    char** schedule, struct spiral_geometry_t* geometry
+) {
+    if(
+        (buffer.size >= SXP_V2_MAGIC_SIZE) &&
+        (memcmp(buffer.bytes, SXP_V2_MAGIC, SXP_V2_MAGIC_SIZE) == 0)
+    ) {
+        return load_spiral_v2(
+            buffer, spiral, solved_only, schedule, geometry
+        );
     }
-    // otherwise, carry on...
-    // now, call run with options from command-line
-    bool result = run(
-        (prepare->count > 0) ? true : false,
-        (generate->count > 0) ? true : false,
-        (render->count > 0) ? true : false,
-        (perfect->count > 0) ? false : true,
-        perfect_threshold->ival[0],
-        line_limit->ival[0],
-        total_lines->ival[0],
-        save_every->ival[0],
-        image_format->sval[0],
-        input_string->sval[0],
-        *input->filename,
-        *output->filename
+    if(schedule != NULL) {
+        *schedule = NULL;
+    }
+    if(geometry != NULL) {
+        geometry->known = false;
+    }
+    return sxbp_load_spiral(buffer, spiral);
+}
+
+/*
+ * private structure, one step of a perfection schedule: the lines from the
+ * given one on are solved with the given perfection threshold, -1 if disabled
+ */
+struct schedule_step_t {
+    uint32_t line; // index of the first line the step applies to
+    int perfection; // perfection threshold to solve them with
+};
+
+/*
+ * private structure, the perfection thresholds the lines of a spiral are solved
+ * with, as steps in order of the line they start at. as text, it's a list of
+ * LINE:THRESHOLD separated by commas, with D for a disabled threshold, such as
+ * "0:4,120:1,300:0".
+ */
+struct perfection_schedule_t {
+    struct schedule_step_t* steps; // dynamic array of steps
+    size_t count; // number of steps in the array
+    size_t capacity; // number of steps the array has room for
+    unsigned long changes; // number of times the steps have changed
+};
+
+/*
+ * private function, adds a step to the end of a schedule, merging it with the
+ * last one where that says the same thing.
+ * returns true on success, false if memory couldn't be allocated.
+ */
+static bool add_schedule_step(
+    struct perfection_schedule_t* schedule, uint32_t line, int perfection
+) {
+    struct schedule_step_t* last = (
+        (schedule->count > 0) ? &schedule->steps[schedule->count - 1] : NULL
     );
+    if((last != NULL) && (last->perfection == perfection)) {
+        // it carries on with the same threshold
+        return true;
+    } else if((last != NULL) && (last->line == line)) {
+        // the last step never got to apply to any lines
+        schedule->count--;
+        return add_schedule_step(schedule, line, perfection);
+    }
+    if(schedule->count == schedule->capacity) {
+        size_t capacity = (
+            (schedule->capacity == 0) ? 8 : schedule->capacity * 2
+        );
+        struct schedule_step_t* steps = realloc(
+            schedule->steps, capacity * sizeof(struct schedule_step_t)
+        );
+        if(steps == NULL) {
+            return false;
+        }
+        schedule->steps = steps;
+        schedule->capacity = capacity;
+    }
+    schedule->steps[schedule->count].line = line;
+    schedule->steps[schedule->count].perfection = perfection;
+    schedule->count++;
+    schedule->changes++;
+    return true;
+}
+
+/*
+ * private function, reads a schedule written as text into the given schedule,
+ * which must be empty. the lines the steps start at must go up.
+ * returns true on success, false if the text isn't a valid schedule or memory
+ * couldn't be allocated.
+ */
+static bool parse_schedule(
+    const char* text, struct perfection_schedule_t* schedule
+) {
+    const char* cursor = text;
+    while(true) {
+        char* end = NULL;
+        if((*cursor < '0') || (*cursor > '9')) {
+            return false;
+        }
+        errno = 0;
+        unsigned long line = strtoul(cursor, &end, 10);
+        if((errno != 0) || (line > UINT32_MAX) || (*end != ':')) {
+            return false;
+        }
+        cursor = end + 1;
+        int perfection = -1;
+        if(*cursor == 'D') {
+            cursor++;
+        } else if((*cursor >= '0') && (*cursor <= '9')) {
+            long threshold = strtol(cursor, &end, 10);
+            if((errno != 0) || (threshold > INT_MAX)) {
+                return false;
+            }
+            perfection = (int)threshold;
+            cursor = end;
+        } else {
+            return false;
+        }
+        if(
+            (
+                (schedule->count > 0) &&
+                (schedule->steps[schedule->count - 1].line >= line)
+            ) ||
+            !add_schedule_step(schedule, (uint32_t)line, perfection)
+        ) {
+            return false;
+        }
+        if(*cursor == '\0') {
+            return true;
+        } else if(*cursor != ',') {
+            return false;
+        }
+        cursor++;
+    }
+}
+
+// private function, returns the most room the text of a schedule can take
+static size_t schedule_text_size(const struct perfection_schedule_t* schedule) {
+    // each step is at most 10 digits, a colon, 10 more digits and a comma
+    return schedule->count * 22 + 1;
+}
+
+/*
+ * private function, writes a schedule as text, as parse_schedule() reads it,
+ * into the given text, which must have room for schedule_text_size() bytes
+ */
+static void write_schedule(
+    const struct perfection_schedule_t* schedule, char* text, size_t size
+) {
+    size_t length = 0;
+    text[0] = '\0';
+    for(size_t i = 0; i < schedule->count; i++) {
+        const char* separator = (i > 0) ? "," : "";
+        if(schedule->steps[i].perfection < 0) {
+            length += (size_t)snprintf(
+                text + length, size - length, "%s%" PRIu32 ":D", separator,
+                schedule->steps[i].line
+            );
+        } else {
+            length += (size_t)snprintf(
+                text + length, size - length, "%s%" PRIu32 ":%d", separator,
+                schedule->steps[i].line, schedule->steps[i].perfection
+            );
+        }
+    }
+}
+
+/*
+ * private function, writes a schedule as text, as parse_schedule() reads it.
+ * returns the text, allocated with malloc(), or NULL if memory couldn't be
+ * allocated for it.
+ */
+static char* format_schedule(const struct perfection_schedule_t* schedule) {
+    size_t size = schedule_text_size(schedule);
+    char* text = malloc(size);
+    if(text != NULL) {
+        write_schedule(schedule, text, size);
+    }
+    return text;
+}
+
+/*
+ * private function, returns the perfection threshold a schedule gives the line
+ * at the given index, that of its first step for lines before that starts
+ */
+static int scheduled_perfection(
+    const struct perfection_schedule_t* schedule, uint32_t line
+) {
+    size_t i = 0;
+    while((i + 1 < schedule->count) && (schedule->steps[i + 1].line <= line)) {
+        i++;
+    }
+    return schedule->steps[i].perfection;
+}
+
+/*
+ * private function, returns the index of the line the next step of a schedule
+ * after the line at the given index starts at, UINT32_MAX if there are no more
+ */
+static uint32_t next_schedule_line(
+    const struct perfection_schedule_t* schedule, uint32_t line
+) {
+    for(size_t i = 0; i < schedule->count; i++) {
+        if(schedule->steps[i].line > line) {
+            return schedule->steps[i].line;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// enum for representing different spiral render modes
+enum spiral_render_mode_t {
+    RENDER_MODE_SXP, RENDER_MODE_PBM, RENDER_MODE_PNG,
+    // the v2 sxp format, plain or compressed
+    RENDER_MODE_SXP_V2, RENDER_MODE_SXP_V2_COMPRESSED,
+    // vector image, written by sxbp itself rather than libsxbp
+    RENDER_MODE_SVG,
+};
+
+// private function, returns whether the given mode dumps to an sxp file
+static bool is_sxp_render_mode(enum spiral_render_mode_t render_mode) {
+    return (
+        (render_mode == RENDER_MODE_SXP) ||
+        (render_mode == RENDER_MODE_SXP_V2) ||
+        (render_mode == RENDER_MODE_SXP_V2_COMPRESSED)
+    );
+}
+
+/*
+ * private function, serialises the given spiral into the given buffer in the
+ * given format, either dumping it as an sxp file or rendering it to an image.
+ * v2 sxp files record the given perfection schedule too, unless it's NULL,
+ * and the given geometry if it says to (see dump_spiral_v2()).
+ * capacity is set to that of the buffer if it came from the buffer pool, or 0
+ * if libsxbp allocated it, it must be freed with free_serialised().
+ * errors are printed to stderr.
+ * returns true on success, false on failure.
+ */
+static bool serialise_spiral(
+    sxbp_spiral_t spiral, enum spiral_render_mode_t render_mode,
+    const char* schedule, const struct spiral_geometry_t* geometry,
+    sxbp_buffer_t* buffer, size_t* capacity
+) {
+    *capacity = 0;
+    if(render_mode == RENDER_MODE_SXP) {
+        // we must simply dump the spiral as-is
+        sxbp_serialise_result_t result = sxbp_dump_spiral(spiral, buffer);
+        // if we had problems, print to stderr and quit
+        if(result.status != SXBP_OPERATION_OK) {
+            fprintf(
+                stderr,
+                "Error Code:\t\t%s\nFile Error Code:\t%s\n",
+                error_code_string(result.status),
+                file_error_code_string(result.diagnostic)
+            );
+            return false;
+        }
+        return true;
+    } else if(is_sxp_render_mode(render_mode)) {
+        bool compressed = (render_mode == RENDER_MODE_SXP_V2_COMPRESSED);
+        if(
+            !dump_spiral_v2(
+                &spiral, compressed, schedule, geometry, buffer, capacity
+            )
+        ) {
+            fprintf(
+                stderr, "Error Code: %s\n",
+                error_code_string(SXBP_MALLOC_REFUSED)
+            );
+            return false;
+        }
+        return true;
+    }
+    /*
+     * render spiral to image, using the render function for the format and
+     * store data in buffer - handle error if any
+     */
+    sxbp_status_t error = SXBP_STATE_UNKNOWN;
+    if(render_mode == RENDER_MODE_PBM) {
+        // render to PBM format
+        error = sxbp_render_spiral_image(
+            spiral, buffer, sxbp_render_backend_pbm
+        );
+    } else if(render_mode == RENDER_MODE_PNG) {
+        // render to PNG format
+        error = sxbp_render_spiral_image(
+            spiral, buffer, sxbp_render_backend_png
+        );
+    }
+    return !handle_error(error);
+}
+
+/*
+ * private function, frees a buffer serialise_spiral() filled, giving it back
+ * to the buffer pool if that's where it came from
+ */
+static void free_serialised(sxbp_buffer_t* buffer, size_t capacity) {
+    if(capacity > 0) {
+        release_buffer(buffer->bytes, capacity);
+    } else {
+        free(buffer->bytes);
+    }
+    buffer->bytes = NULL;
+    buffer->size = 0;
+}
+
+// size of the blocks output is written in, a multiple of any likely page size
+#define OUTPUT_BLOCK_SIZE (1024 * 1024)
+
+/*
+ * private structure, writes output to a file or stdout in big blocks as it is
+ * produced, so that it never has to all be held in memory at once.
+ * a file is written as a temporary file next to it, which is flushed to disk
+ * then renamed over it once complete, so the file at that path is only ever
+ * seen complete.
+ */
+struct output_stream_t {
+    int descriptor; // file descriptor being written to
+    sxbp_buffer_t* memory; // buffer written to instead, if not NULL
+    const char* file_path; // path of the file to write to, NULL for stdout
+    char* temp_path; // path of the temporary file, NULL for stdout
+    uint8_t* block; // output waiting to be written, from the buffer pool
+    size_t block_capacity; // capacity of the block, to give back to the pool
+    size_t block_used; // number of bytes of output in the block
+    uint64_t written; // total number of bytes written so far
+    bool direct; // whether the file was opened with O_DIRECT
+    bool failed; // whether anything went wrong
+};
+
+/*
+ * number of temporary files made so far, so that threads writing to the same
+ * path at the same time don't write to the same temporary file
+ */
+static unsigned long temp_file_count = 0;
+// guards temp_file_count
+static pthread_mutex_t temp_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * private function, writes all of the given bytes to a file descriptor,
+ * retrying after short writes and interruptions.
+ * returns true on success and false on failure.
+ */
+static bool write_all(int descriptor, const uint8_t* bytes, size_t size) {
+    while(size > 0) {
+        ssize_t result = write(descriptor, bytes, size);
+        if(result < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += result;
+        size -= (size_t)result;
+    }
+    return true;
+}
+
+/*
+ * private function, writes all of the given bytes to the output stream's file
+ * descriptor, or appends them to its memory buffer if it has one.
+ * returns true on success and false on failure.
+ */
+static bool write_stream_bytes(
+    struct output_stream_t* stream, const uint8_t* bytes, size_t size
+) {
+    if(stream->memory == NULL) {
+        return write_all(stream->descriptor, bytes, size);
+    }
+    if(size == 0) {
+        return true;
+    } else if(size > SIZE_MAX - stream->memory->size) {
+        return false;
+    }
+    uint8_t* grown = realloc(
+        stream->memory->bytes, stream->memory->size + size
+    );
+    if(grown == NULL) {
+        return false;
+    }
+    memcpy(grown + stream->memory->size, bytes, size);
+    stream->memory->bytes = grown;
+    stream->memory->size += size;
+    return true;
+}
+
+/*
+ * private function, opens an output stream to the file at the given path, or
+ * to stdout if the path is "-".
+ * if size is not 0, it's how big the output is going to be, so space can be
+ * set aside for the file up front. if direct is true, the file is written with
+ * O_DIRECT where supported, bypassing the page cache.
+ * returns true on success and false on failure.
+ */
+static bool open_output_stream(
+    struct output_stream_t* stream, const char* file_path, uint64_t size,
+    bool direct
+) {
+    stream->descriptor = -1;
+    stream->memory = NULL;
+    stream->file_path = NULL;
+    stream->temp_path = NULL;
+    stream->block_used = 0;
+    stream->written = 0;
+    stream->direct = false;
+    stream->failed = false;
+    // pooled buffers are page-aligned, as O_DIRECT needs
+    stream->block = acquire_buffer(OUTPUT_BLOCK_SIZE, &stream->block_capacity);
+    if(stream->block == NULL) {
+        return false;
+    }
+    if(strcmp(file_path, "-") == 0) {
+        stream->descriptor = STDOUT_FILENO;
+        stream->memory = standard_output_buffer();
+        return true;
+    }
+    // the temporary file is made unique to this process and this stream
+    size_t temp_path_size = strlen(file_path) + 48;
+    stream->temp_path = malloc(temp_path_size);
+    if(stream->temp_path == NULL) {
+        release_buffer(stream->block, stream->block_capacity);
+        return false;
+    }
+    pthread_mutex_lock(&temp_file_lock);
+    unsigned long temp_file_number = temp_file_count++;
+    pthread_mutex_unlock(&temp_file_lock);
+    snprintf(
+        stream->temp_path, temp_path_size, "%s.%ld.%lu.tmp", file_path,
+        (long)getpid(), temp_file_number
+    );
+    stream->file_path = file_path;
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    if(direct) {
+        stream->descriptor = open(stream->temp_path, flags | O_DIRECT, 0666);
+        // not all filesystems support it, so try again without if it fails
+        stream->direct = (stream->descriptor != -1);
+    }
+#else
+    // no-op, this system has no O_DIRECT
+    (void)direct;
+#endif
+    if(stream->descriptor == -1) {
+        stream->descriptor = open(stream->temp_path, flags, 0666);
+    }
+    if(stream->descriptor == -1) {
+        free(stream->temp_path);
+        release_buffer(stream->block, stream->block_capacity);
+        return false;
+    }
+    /*
+     * set aside space for the whole file, so it can be laid out in one piece.
+     * this is only a hint, so it doesn't matter if the filesystem can't do it
+     */
+    if((size > 0) && (size <= (uint64_t)INT64_MAX)) {
+        posix_fallocate(stream->descriptor, 0, (off_t)size);
+    }
+    return true;
+}
+
+/*
+ * private function, writes out the output stream's block if it's got anything
+ * in it
+ */
+static void flush_output_block(struct output_stream_t* stream) {
+    if((stream->block_used > 0) && !stream->failed) {
+        stream->failed = !write_stream_bytes(
+            stream, stream->block, stream->block_used
+        );
+        stream->written += stream->block_used;
+    }
+    stream->block_used = 0;
+}
+
+/*
+ * private function, writes the given bytes to the output stream.
+ * returns true on success and false on failure.
+ */
+static bool write_output_stream(
+    struct output_stream_t* stream, const void* data, size_t size
+) {
+    const uint8_t* bytes = data;
+    while((size > 0) && !stream->failed) {
+        // whole blocks can go straight out without copying, unless O_DIRECT
+        if(
+            !stream->direct && (stream->block_used == 0) &&
+            (size >= OUTPUT_BLOCK_SIZE)
+        ) {
+            size_t whole_blocks = size - size % OUTPUT_BLOCK_SIZE;
+            stream->failed = !write_stream_bytes(stream, bytes, whole_blocks);
+            stream->written += whole_blocks;
+            bytes += whole_blocks;
+            size -= whole_blocks;
+            continue;
+        }
+        size_t space = OUTPUT_BLOCK_SIZE - stream->block_used;
+        size_t amount = (size < space) ? size : space;
+        memcpy(stream->block + stream->block_used, bytes, amount);
+        stream->block_used += amount;
+        bytes += amount;
+        size -= amount;
+        if(stream->block_used == OUTPUT_BLOCK_SIZE) {
+            flush_output_block(stream);
+        }
+    }
+    return !stream->failed;
+}
+
+/*
+ * private function, finishes with an output stream. if commit is true and
+ * everything was written, the output is flushed to disk and renamed into
+ * place, otherwise it's thrown away.
+ * returns true if the output was committed, false if not.
+ */
+static bool close_output_stream(struct output_stream_t* stream, bool commit) {
+    commit = commit && !stream->failed;
+#ifdef O_DIRECT
+    if(commit && stream->direct && (stream->block_used > 0)) {
+        // the last block is probably short, which O_DIRECT doesn't allow
+        int flags = fcntl(stream->descriptor, F_GETFL);
+        commit = (
+            (flags != -1) &&
+            (fcntl(stream->descriptor, F_SETFL, flags & ~O_DIRECT) != -1)
+        );
+    }
+#endif
+    if(commit) {
+        flush_output_block(stream);
+        commit = !stream->failed;
+    }
+    if(stream->file_path != NULL) {
+        if(commit && (stream->written <= (uint64_t)INT64_MAX)) {
+            // in case space was set aside for more than was written
+            commit = (
+                ftruncate(stream->descriptor, (off_t)stream->written) == 0
+            );
+            // make sure it's all on disk before it replaces the old file
+            commit = commit && (fsync(stream->descriptor) == 0);
+        }
+        commit = (close(stream->descriptor) == 0) && commit;
+        commit = commit && (rename(stream->temp_path, stream->file_path) == 0);
+        if(!commit) {
+            remove(stream->temp_path);
+        }
+    }
+    free(stream->temp_path);
+    release_buffer(stream->block, stream->block_capacity);
+    return commit;
+}
+
+/*
+ * private function, writes a buffer to the file at the given path, or stdout if
+ * the path is "-", such that the file at that path is only ever seen complete.
+ * returns true on success and false on failure.
+ */
+static bool buffer_to_path(
+    const sxbp_buffer_t* buffer, const char* file_path, bool direct
+) {
+    struct output_stream_t stream;
+    if(!open_output_stream(&stream, file_path, buffer->size, direct)) {
+        return false;
+    }
+    bool ok = write_output_stream(&stream, buffer->bytes, buffer->size);
+    return close_output_stream(&stream, ok);
+}
+
+/*
+ * private structure, how a spiral is laid out when it's rendered to an image:
+ * optionally scaled down, and optionally split up into tiles
+ */
+struct render_view_t {
+    uint32_t scale; // the image is this many times smaller than full size
+    uint32_t tile_width; // width of each tile in pixels, 0 for no tiles
+    uint32_t tile_height; // height of each tile in pixels, 0 for no tiles
+    int jobs; // number of tiles to render, or PNG blocks to deflate, at once
+    int png_level; // zlib compression level to deflate PNG images at
+};
+
+/*
+ * private structure, the pixels one line of a spiral covers in its rendered
+ * image, which are always in one row or one column
+ */
+struct raster_segment_t {
+    uint32_t first_row; // topmost row of the pixels
+    uint32_t last_row; // bottommost row of the pixels
+    uint32_t first_column; // leftmost column of the pixels
+    uint32_t last_column; // rightmost column of the pixels
+    uint32_t step; // distance between pixels, the first line skips every other
+};
+
+/*
+ * private structure, the pixels of a whole spiral's image as a list of line
+ * segments, sorted from top to bottom
+ */
+struct raster_outline_t {
+    uint32_t width; // width of the image in pixels
+    uint32_t height; // height of the image in pixels
+    struct raster_segment_t* segments; // segments, sorted by first row
+    size_t segment_count; // number of segments
+};
+
+/*
+ * private structure, a window onto a 1-bit image already drawn in memory,
+ * which can be rendered in place of an outline
+ */
+struct raster_window_t {
+    const uint8_t* pixels; // the image's rows, packed as the rasteriser's are
+    size_t row_size; // size of one of the image's rows in bytes
+    uint32_t left; // column of the image the window's left edge is at
+    uint32_t top; // row of the image the window's top edge is at
+    uint32_t width; // width of the window in pixels
+    uint32_t height; // height of the window in pixels
+};
+
+/*
+ * private structure, renders a list of segments to a 1-bit image one row of
+ * pixels at a time, top to bottom. only the current row is held in memory, so
+ * memory use depends only on the number of segments, not the size of the image.
+ * it can also copy the rows out of a window instead.
+ */
+struct rasteriser_t {
+    uint32_t width; // width of the image in pixels
+    uint32_t height; // height of the image in pixels
+    size_t row_size; // size of a row in bytes, padded to a whole byte
+    uint8_t* row; // current row, 8 pixels to a byte, MSB first, 1 is ink
+    size_t row_capacity; // capacity of the row, to give back to the pool
+    uint32_t next_row; // index of the row that will be rendered next
+    const struct raster_segment_t* segments; // segments, sorted by first row
+    size_t segment_count; // number of segments
+    size_t next_segment; // index of the first segment not yet reached
+    const struct raster_segment_t** active; // segments crossing current row
+    size_t active_capacity; // capacity of active, to give back to the pool
+    size_t active_count; // number of active segments
+    // if its pixels aren't NULL, window rows are copied from instead
+    struct raster_window_t window;
+};
+
+// private function, for sorting raster segments from top to bottom
+static int compare_raster_segments(const void* a, const void* b) {
+    uint32_t a_row = ((const struct raster_segment_t*)a)->first_row;
+    uint32_t b_row = ((const struct raster_segment_t*)b)->first_row;
+    return (a_row > b_row) - (a_row < b_row);
+}
+
+/*
+ * private function, works out the segments of pixels covered by the solved
+ * lines of the given spiral, which has the given bounds. the image is laid out
+ * exactly as libsxbp lays it out: at twice the scale of the spiral's co-ords,
+ * with a one pixel margin all round. if scale is more than 1, the image is
+ * shrunk by that much, with each pixel inked if any of the pixels it stands in
+ * for would have been.
+ * returns true on success and false on failure.
+ */
+static bool trace_raster_outline(
+    const sxbp_spiral_t* spiral, const struct spiral_bounds_t* bounds,
+    uint32_t scale, struct raster_outline_t* outline
+) {
+    int64_t min_x = bounds->min_x, max_y = bounds->max_y;
+    int64_t width = (bounds->max_x - min_x) * 2 + 3;
+    int64_t height = (max_y - bounds->min_y) * 2 + 3;
+    if((width > (int64_t)UINT32_MAX) || (height > (int64_t)UINT32_MAX)) {
+        fprintf(stderr, "%s\n", "Spiral is too big to render");
+        return false;
+    }
+    // round up, so that the last pixels still have somewhere to go
+    outline->width = (uint32_t)((width + scale - 1) / scale);
+    outline->height = (uint32_t)((height + scale - 1) / scale);
+    // one segment for each line, plus one for the pixel at the origin
+    outline->segments = calloc(
+        (size_t)spiral->solved_count + 1, sizeof(struct raster_segment_t)
+    );
+    if(outline->segments == NULL) {
+        return false;
+    }
+    // pixel co-ords of a point in the spiral at twice scale
+    #define RASTER_COLUMN(X) ((uint32_t)(((X) - min_x * 2 + 1) / scale))
+    #define RASTER_ROW(Y) ((uint32_t)((max_y * 2 - (Y) + 1) / scale))
+    struct raster_segment_t* segment = outline->segments;
+    segment->first_row = segment->last_row = RASTER_ROW(0);
+    segment->first_column = segment->last_column = RASTER_COLUMN(0);
+    segment->step = 1;
+    segment++;
+    int64_t x = 0, y = 0;
+    for(uint32_t i = 0; i < spiral->solved_count; i++) {
+        sxbp_vector_t vector = (
+            SXBP_VECTOR_DIRECTIONS[spiral->lines[i].direction]
+        );
+        int64_t length = spiral->lines[i].length;
+        if(length == 0) {
+            continue;
+        }
+        /*
+         * each line covers the pixels from one after its start to its end, but
+         * the first line only covers the ones that land on whole co-ords
+         */
+        int64_t step = (i == 0) ? 2 : 1;
+        int64_t start_x = x * 2 + vector.x * step;
+        int64_t start_y = y * 2 + vector.y * step;
+        x += vector.x * length;
+        y += vector.y * length;
+        uint32_t start_column = RASTER_COLUMN(start_x);
+        uint32_t start_row = RASTER_ROW(start_y);
+        uint32_t end_column = RASTER_COLUMN(x * 2);
+        uint32_t end_row = RASTER_ROW(y * 2);
+        segment->first_row = (start_row < end_row) ? start_row : end_row;
+        segment->last_row = (start_row < end_row) ? end_row : start_row;
+        segment->first_column = (
+            (start_column < end_column) ? start_column : end_column
+        );
+        segment->last_column = (
+            (start_column < end_column) ? end_column : start_column
+        );
+        // when scaled down, the gaps in the first line are filled in
+        segment->step = (scale == 1) ? (uint32_t)step : 1;
+        segment++;
+    }
+    #undef RASTER_COLUMN
+    #undef RASTER_ROW
+    outline->segment_count = (size_t)(segment - outline->segments);
+    qsort(
+        outline->segments, outline->segment_count,
+        sizeof(struct raster_segment_t), compare_raster_segments
+    );
+    return true;
+}
+
+/*
+ * private function, moves the start of a run of pixels which are step apart
+ * forward to the first of them that isn't before limit.
+ * returns false if there are none left by then.
+ */
+static bool clip_raster_run(
+    uint32_t* first, uint32_t last, uint32_t step, uint32_t limit
+) {
+    if(*first < limit) {
+        uint64_t skipped = ((uint64_t)(limit - *first) + step - 1) / step;
+        uint64_t clipped = *first + skipped * step;
+        if(clipped > last) {
+            return false;
+        }
+        *first = (uint32_t)clipped;
+    }
+    return true;
+}
+
+/*
+ * private function, makes a new outline of the part of the given outline that
+ * lies in the given rectangle, with co-ords relative to its top-left corner.
+ * returns true on success and false on failure.
+ */
+static bool clip_raster_outline(
+    const struct raster_outline_t* outline, uint32_t left, uint32_t top,
+    uint32_t width, uint32_t height, struct raster_outline_t* clipped
+) {
+    uint32_t right = left + (width - 1);
+    uint32_t bottom = top + (height - 1);
+    clipped->width = width;
+    clipped->height = height;
+    clipped->segment_count = 0;
+    // count them first, so as to allocate only as much as is needed
+    size_t count = 0;
+    for(size_t i = 0; i < outline->segment_count; i++) {
+        const struct raster_segment_t* segment = &outline->segments[i];
+        if(
+            (segment->last_row >= top) && (segment->first_row <= bottom) &&
+            (segment->last_column >= left) && (segment->first_column <= right)
+        ) {
+            count++;
+        }
+    }
+    clipped->segments = calloc(
+        (count > 0) ? count : 1, sizeof(struct raster_segment_t)
+    );
+    if(clipped->segments == NULL) {
+        return false;
+    }
+    /*
+     * segments stay sorted, as those starting above the top are all moved down
+     * to it and the rest keep their order
+     */
+    for(size_t i = 0; i < outline->segment_count; i++) {
+        struct raster_segment_t segment = outline->segments[i];
+        if(
+            (segment.last_row < top) || (segment.first_row > bottom) ||
+            (segment.last_column < left) || (segment.first_column > right) ||
+            !clip_raster_run(
+                &segment.first_row, segment.last_row, segment.step, top
+            ) ||
+            !clip_raster_run(
+                &segment.first_column, segment.last_column, segment.step, left
+            )
+        ) {
+            continue;
+        }
+        segment.last_row = (
+            (segment.last_row < bottom) ? segment.last_row : bottom
+        );
+        segment.last_column = (
+            (segment.last_column < right) ? segment.last_column : right
+        );
+        segment.first_row -= top;
+        segment.last_row -= top;
+        segment.first_column -= left;
+        segment.last_column -= left;
+        clipped->segments[clipped->segment_count++] = segment;
+    }
+    return true;
+}
+
+// private function, frees the memory allocated for a rasteriser
+static void free_rasteriser(struct rasteriser_t* rasteriser) {
+    release_buffer(rasteriser->row, rasteriser->row_capacity);
+    release_buffer((void*)rasteriser->active, rasteriser->active_capacity);
+    rasteriser->row = NULL;
+    rasteriser->active = NULL;
+}
+
+/*
+ * private function, prepares a rasteriser to render the given outline, which
+ * must outlive it.
+ * returns true on success and false on failure.
+ */
+static bool start_rasteriser(
+    struct rasteriser_t* rasteriser, const struct raster_outline_t* outline
+) {
+    memset(rasteriser, 0, sizeof(struct rasteriser_t));
+    rasteriser->width = outline->width;
+    rasteriser->height = outline->height;
+    rasteriser->row_size = ((size_t)outline->width + 7) / 8;
+    rasteriser->segments = outline->segments;
+    rasteriser->segment_count = outline->segment_count;
+    // these are the same size for every image of a run, so they're pooled
+    rasteriser->row = acquire_buffer(
+        rasteriser->row_size, &rasteriser->row_capacity
+    );
+    rasteriser->active = acquire_buffer(
+        ((outline->segment_count > 0) ? outline->segment_count : 1) *
+        sizeof(struct raster_segment_t*),
+        &rasteriser->active_capacity
+    );
+    if((rasteriser->row == NULL) || (rasteriser->active == NULL)) {
+        free_rasteriser(rasteriser);
+        return false;
+    }
+    memset(rasteriser->row, 0, rasteriser->row_size);
+    return true;
+}
+
+/*
+ * private function, prepares a rasteriser to copy the rows of the given window,
+ * whose pixels must outlive it.
+ * returns true on success and false on failure.
+ */
+static bool start_window_rasteriser(
+    struct rasteriser_t* rasteriser, const struct raster_window_t* window
+) {
+    memset(rasteriser, 0, sizeof(struct rasteriser_t));
+    rasteriser->width = window->width;
+    rasteriser->height = window->height;
+    rasteriser->row_size = ((size_t)window->width + 7) / 8;
+    rasteriser->window = *window;
+    rasteriser->row = acquire_buffer(
+        rasteriser->row_size, &rasteriser->row_capacity
+    );
+    if(rasteriser->row == NULL) {
+        return false;
+    }
+    memset(rasteriser->row, 0, rasteriser->row_size);
+    return true;
+}
+
+// private function, sets the pixel in the given column of a packed row
+static void set_raster_pixel(uint8_t* row, uint32_t column) {
+    row[column / 8] |= (uint8_t)(0x80u >> (column % 8));
+}
+
+/*
+ * private function, sets all the pixels from the first to the last column of a
+ * packed row, a whole byte at a time where it can. the whole bytes in the
+ * middle are set with memset(), which the C library does a machine word or
+ * vector register at a time.
+ */
+static void fill_raster_span(
+    uint8_t* row, uint32_t first_column, uint32_t last_column
+) {
+    size_t first_byte = first_column / 8;
+    size_t last_byte = last_column / 8;
+    // pixels are MSB first, so these mask off the bits outside of the span
+    uint8_t first_mask = (uint8_t)(0xffu >> (first_column % 8));
+    uint8_t last_mask = (uint8_t)(0xff00u >> (last_column % 8 + 1));
+    if(first_byte == last_byte) {
+        row[first_byte] |= (uint8_t)(first_mask & last_mask);
+        return;
+    }
+    row[first_byte] |= first_mask;
+    memset(row + first_byte + 1, 0xff, last_byte - first_byte - 1);
+    row[last_byte] |= last_mask;
+}
+
+/*
+ * private function, renders the next row of the rasteriser's image.
+ * returns the row, packed 8 pixels to a byte, MSB first, with 1 for ink. it's
+ * only valid until the next call.
+ */
+static const uint8_t* next_raster_row(struct rasteriser_t* rasteriser) {
+    uint32_t row_index = rasteriser->next_row++;
+    const struct raster_window_t* window = &rasteriser->window;
+    if(window->pixels != NULL) {
+        // shift the row along, as the window needn't start on a whole byte
+        const uint8_t* source = (
+            window->pixels +
+            ((size_t)window->top + row_index) * window->row_size +
+            window->left / 8
+        );
+        size_t available = window->row_size - window->left / 8;
+        unsigned shift = window->left % 8;
+        for(size_t i = 0; i < rasteriser->row_size; i++) {
+            unsigned byte = (unsigned)source[i] << shift;
+            if((shift > 0) && (i + 1 < available)) {
+                byte |= (unsigned)source[i + 1] >> (8 - shift);
+            }
+            rasteriser->row[i] = (uint8_t)byte;
+        }
+        // leave the padding at the end of the row clear
+        if(rasteriser->width % 8 != 0) {
+            rasteriser->row[rasteriser->row_size - 1] &= (uint8_t)(
+                0xff00u >> (rasteriser->width % 8)
+            );
+        }
+        return rasteriser->row;
+    }
+    memset(rasteriser->row, 0, rasteriser->row_size);
+    // pick up the segments which start on this row
+    while(
+        (rasteriser->next_segment < rasteriser->segment_count) &&
+        (rasteriser->segments[rasteriser->next_segment].first_row == row_index)
+    ) {
+        rasteriser->active[rasteriser->active_count++] = (
+            &rasteriser->segments[rasteriser->next_segment++]
+        );
+    }
+    for(size_t i = 0; i < rasteriser->active_count;) {
+        const struct raster_segment_t* segment = rasteriser->active[i];
+        if((segment->first_row == segment->last_row) && (segment->step == 1)) {
+            // horizontal, all of it is on this row in one solid run
+            fill_raster_span(
+                rasteriser->row, segment->first_column, segment->last_column
+            );
+        } else if(segment->first_row == segment->last_row) {
+            // horizontal but gappy, only the first line is like this
+            for(
+                uint32_t column = segment->first_column;;
+                column += segment->step
+            ) {
+                set_raster_pixel(rasteriser->row, column);
+                if(segment->last_column - column < segment->step) {
+                    break;
+                }
+            }
+        } else if((row_index - segment->first_row) % segment->step == 0) {
+            // vertical, one pixel of it is on this row
+            set_raster_pixel(rasteriser->row, segment->first_column);
+        }
+        // drop the segment once we've reached the bottom of it
+        if(segment->last_row == row_index) {
+            rasteriser->active[i] = (
+                rasteriser->active[--rasteriser->active_count]
+            );
+        } else {
+            i++;
+        }
+    }
+    return rasteriser->row;
+}
+
+/*
+ * private function, renders the rasteriser's image as a PBM image straight
+ * into the file at the given path, or stdout if the path is "-", one row at a
+ * time.
+ * returns true on success and false on failure.
+ */
+static bool raster_to_pbm(
+    struct rasteriser_t* rasteriser, const char* file_path, bool direct
+) {
+    char header[64];
+    int header_size = snprintf(
+        header, sizeof(header), "P4\n%" PRIu32 "\n%" PRIu32 "\n",
+        rasteriser->width, rasteriser->height
+    );
+    uint64_t size = (
+        (uint64_t)header_size +
+        (uint64_t)rasteriser->row_size * rasteriser->height
+    );
+    struct output_stream_t stream;
+    if(!open_output_stream(&stream, file_path, size, direct)) {
+        return false;
+    }
+    bool ok = write_output_stream(&stream, header, (size_t)header_size);
+    for(uint32_t i = 0; ok && (i < rasteriser->height); i++) {
+        ok = write_output_stream(
+            &stream, next_raster_row(rasteriser), rasteriser->row_size
+        );
+    }
+    return close_output_stream(&stream, ok);
+}
+
+// the 8 bytes every PNG file starts with
+#define PNG_SIGNATURE "\x89PNG\r\n\x1a\n"
+// about how many bytes of scanlines go into each block deflated on its own
+#define PNG_BLOCK_SIZE (128 * 1024)
+// most bytes back deflate can refer to, so the most a block needs of the last
+#define PNG_DICTIONARY_SIZE 32768
+
+/*
+ * private structure, a block of rows of a PNG image, which is deflated into an
+ * IDAT chunk of its own
+ */
+struct png_block_t {
+    uint8_t* input; // the rows' scanlines, each a filter byte then the pixels
+    size_t input_capacity; // capacity of input, to give back to the pool
+    size_t input_size; // size of the scanlines in bytes
+    // the end of the scanlines before these, which deflate can refer back to
+    uint8_t dictionary[PNG_DICTIONARY_SIZE];
+    size_t dictionary_size; // number of bytes of the dictionary used
+    uint8_t* chunk; // the IDAT chunk the block is deflated into
+    size_t chunk_size; // size of the chunk
+    size_t chunk_capacity; // capacity of the chunk, to give back to the pool
+    uLong adler; // Adler-32 of the scanlines, for the zlib stream's trailer
+    bool first; // whether the block starts the zlib stream
+    bool last; // whether the block ends the zlib stream
+    bool done; // whether the block has been deflated
+    bool ok; // whether it was deflated successfully
+};
+
+/*
+ * private structure, a PNG image being encoded. its rows are rendered in order
+ * into a ring of blocks, which worker threads deflate and which are written out
+ * in order once they're done, so only a few blocks are in memory at once.
+ */
+struct png_encoder_t {
+    struct png_block_t* blocks; // ring of blocks
+    size_t blocks_capacity; // capacity of blocks, to give back to the pool
+    size_t block_count; // number of blocks in the ring
+    int level; // zlib compression level to deflate at
+    size_t produced; // number of blocks rendered so far
+    size_t claimed; // number of blocks taken to be deflated so far
+    bool finished; // whether all blocks have been rendered
+    pthread_mutex_t lock; // guards produced, claimed, finished and done
+    pthread_cond_t changed; // broadcast whenever any of those change
+};
+
+/*
+ * private function, gives the PNG encoder's blocks and their buffers back to
+ * the buffer pool
+ */
+static void free_png_blocks(struct png_encoder_t* encoder) {
+    if(encoder->blocks == NULL) {
+        return;
+    }
+    for(size_t i = 0; i < encoder->block_count; i++) {
+        struct png_block_t* block = &encoder->blocks[i];
+        release_buffer(block->input, block->input_capacity);
+        release_buffer(block->chunk, block->chunk_capacity);
+    }
+    release_buffer(encoder->blocks, encoder->blocks_capacity);
+    encoder->blocks = NULL;
+}
+
+/*
+ * private function, deflates a block of scanlines into an IDAT chunk.
+ * the blocks of an image are deflated separately, pigz-style, then joined into
+ * one zlib stream: all but the last end with a sync flush, so they end on a
+ * byte boundary without ending the stream, and each starts with the data
+ * before it as its dictionary, so it's compressed as well as if it had been
+ * deflated along with it. the first block starts with the zlib header, and
+ * the trailer is written after the last, once all their Adler-32s are known.
+ * returns true on success, false on failure.
+ */
+static bool deflate_png_block(int level, struct png_block_t* block) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // negative window bits give a raw deflate stream, with no header of its own
+    if(
+        deflateInit2(
+            &stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY
+        ) != Z_OK
+    ) {
+        return false;
+    }
+    bool ok = (
+        (block->dictionary_size == 0) ||
+        (
+            deflateSetDictionary(
+                &stream, block->dictionary, (uInt)block->dictionary_size
+            ) == Z_OK
+        )
+    );
+    // room for the chunk's length, type and CRC, the header and a sync flush
+    size_t capacity = deflateBound(&stream, (uLong)block->input_size) + 32;
+    if(ok && (block->chunk_capacity < capacity)) {
+        // what's in it is always overwritten, so it needn't be kept
+        release_buffer(block->chunk, block->chunk_capacity);
+        block->chunk = acquire_buffer(capacity, &block->chunk_capacity);
+        ok = (block->chunk != NULL);
+        block->chunk_capacity = ok ? block->chunk_capacity : 0;
+    }
+    size_t size = 0;
+    if(ok && block->first) {
+        // the zlib header: deflate with a 32 KiB window, and the level in use
+        unsigned int header = 0x7800u | (
+            (level == 0 || level == 1) ? 0x00u :
+            (level >= 2 && level <= 5) ? 0x40u :
+            (level == 6 || level == Z_DEFAULT_COMPRESSION) ? 0x80u : 0xc0u
+        );
+        header += 31 - header % 31;
+        block->chunk[8] = (uint8_t)(header >> 8);
+        block->chunk[9] = (uint8_t)header;
+        size = 2;
+    }
+    if(ok) {
+        stream.next_in = block->input;
+        stream.avail_in = (uInt)block->input_size;
+        stream.next_out = block->chunk + 8 + size;
+        stream.avail_out = (uInt)(block->chunk_capacity - 12 - size);
+        int result = deflate(&stream, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+        // there's room for it all, so it must all be done in one call
+        ok = (
+            block->last ? (result == Z_STREAM_END) :
+            ((result == Z_OK) && (stream.avail_out > 0))
+        ) && (stream.avail_in == 0);
+        size += (size_t)(stream.next_out - (block->chunk + 8 + size));
+    }
+    deflateEnd(&stream);
+    if(!ok) {
+        return false;
+    }
+    store_uint32(block->chunk, (uint32_t)size);
+    memcpy(block->chunk + 4, "IDAT", 4);
+    store_uint32(block->chunk + 8 + size, checksum(block->chunk + 4, size + 4));
+    block->chunk_size = size + 12;
+    block->adler = adler32(
+        adler32(0, Z_NULL, 0), block->input, (uInt)block->input_size
+    );
+    return true;
+}
+
+/*
+ * private function, PNG encoder thread entry point.
+ * deflates blocks as they're rendered until all of them have been taken.
+ */
+static void* png_worker(void* encoder_void_pointer) {
+    struct png_encoder_t* encoder = (
+        (struct png_encoder_t*)encoder_void_pointer
+    );
+    pthread_mutex_lock(&encoder->lock);
+    while(true) {
+        while(
+            (encoder->claimed == encoder->produced) && !encoder->finished
+        ) {
+            pthread_cond_wait(&encoder->changed, &encoder->lock);
+        }
+        if(encoder->claimed == encoder->produced) {
+            // all blocks have been rendered and taken
+            break;
+        }
+        struct png_block_t* block = (
+            &encoder->blocks[encoder->claimed++ % encoder->block_count]
+        );
+        pthread_mutex_unlock(&encoder->lock);
+        block->ok = deflate_png_block(encoder->level, block);
+        pthread_mutex_lock(&encoder->lock);
+        block->done = true;
+        pthread_cond_broadcast(&encoder->changed);
+    }
+    pthread_mutex_unlock(&encoder->lock);
+    return NULL;
+}
+
+/*
+ * private function, waits for the block with the given index to be deflated,
+ * deflating it on the calling thread if no worker has taken it yet.
+ * returns the block.
+ */
+static struct png_block_t* finish_png_block(
+    struct png_encoder_t* encoder, size_t index
+) {
+    struct png_block_t* block = &encoder->blocks[index % encoder->block_count];
+    pthread_mutex_lock(&encoder->lock);
+    // blocks are taken in order, so if this one hasn't been it's next
+    if(encoder->claimed == index) {
+        encoder->claimed++;
+        pthread_mutex_unlock(&encoder->lock);
+        block->ok = deflate_png_block(encoder->level, block);
+        pthread_mutex_lock(&encoder->lock);
+        block->done = true;
+    }
+    while(!block->done) {
+        pthread_cond_wait(&encoder->changed, &encoder->lock);
+    }
+    pthread_mutex_unlock(&encoder->lock);
+    return block;
+}
+
+/*
+ * private function, writes a deflated block to the given output stream and adds
+ * its Adler-32 to the one of the blocks before it.
+ * returns true on success and false on failure.
+ */
+static bool write_png_block(
+    struct output_stream_t* stream, const struct png_block_t* block,
+    uLong* adler
+) {
+    *adler = adler32_combine(*adler, block->adler, (z_off_t)block->input_size);
+    return block->ok && write_output_stream(
+        stream, block->chunk, block->chunk_size
+    );
+}
+
+/*
+ * private function, renders the rasteriser's image as a PNG image straight into
+ * the file at the given path, or stdout if the path is "-", deflating it at the
+ * given zlib level on as many threads as jobs says to. its rows are rendered
+ * in blocks, and deflating each one of them overlaps with rendering the next,
+ * so the whole image is never in memory at once. however many threads it's
+ * encoded on, the image is the same 1-bit greyscale one libsxbp's PNG backend
+ * writes.
+ * returns true on success and false on failure.
+ */
+static bool raster_to_png(
+    struct rasteriser_t* rasteriser, int level, int jobs,
+    const char* file_path, bool direct
+) {
+    // each scanline starts with its filter type, always none for 1-bit images
+    size_t scanline_size = rasteriser->row_size + 1;
+    size_t block_rows = PNG_BLOCK_SIZE / scanline_size;
+    block_rows = (block_rows > 0) ? block_rows : 1;
+    size_t total_blocks = (rasteriser->height + block_rows - 1) / block_rows;
+    // enough blocks in the ring for every worker to have one on the go
+    size_t worker_count = (jobs < 1) ? 1 : (size_t)jobs;
+    worker_count = (
+        (worker_count < total_blocks) ? worker_count : total_blocks
+    );
+    worker_count = (worker_count > 0) ? worker_count : 1;
+    struct png_encoder_t encoder = {
+        .blocks = NULL,
+        .blocks_capacity = 0,
+        .block_count = worker_count + 1,
+        .level = level,
+        .produced = 0,
+        .claimed = 0,
+        .finished = false,
+    };
+    /*
+     * the blocks and their buffers are all pooled, so that an image saved at
+     * every checkpoint reuses the last one's instead of allocating its own
+     */
+    encoder.blocks = acquire_buffer(
+        encoder.block_count * sizeof(struct png_block_t),
+        &encoder.blocks_capacity
+    );
+    bool ok = (encoder.blocks != NULL);
+    if(ok) {
+        memset(
+            encoder.blocks, 0, encoder.block_count * sizeof(struct png_block_t)
+        );
+    }
+    for(size_t i = 0; ok && (i < encoder.block_count); i++) {
+        encoder.blocks[i].input = acquire_buffer(
+            block_rows * scanline_size, &encoder.blocks[i].input_capacity
+        );
+        ok = (encoder.blocks[i].input != NULL);
+    }
+    struct output_stream_t stream;
+    ok = ok && open_output_stream(&stream, file_path, 0, direct);
+    if(!ok) {
+        free_png_blocks(&encoder);
+        return false;
+    }
+    uint8_t header[8 + 25];
+    memcpy(header, PNG_SIGNATURE, 8);
+    store_uint32(header + 8, 13);
+    memcpy(header + 12, "IHDR", 4);
+    store_uint32(header + 16, rasteriser->width);
+    store_uint32(header + 20, rasteriser->height);
+    // 1 bit per pixel, greyscale, deflated, filtered per row, not interlaced
+    memcpy(header + 24, "\x01\x00\x00\x00\x00", 5);
+    store_uint32(header + 29, checksum(header + 12, 17));
+    ok = write_output_stream(&stream, header, sizeof(header));
+    pthread_mutex_init(&encoder.lock, NULL);
+    pthread_cond_init(&encoder.changed, NULL);
+    // the calling thread renders and writes the blocks, and deflates some too
+    pthread_t* workers = calloc(worker_count, sizeof(pthread_t));
+    size_t started = 0;
+    while(
+        (workers != NULL) && (started < worker_count - 1) &&
+        (pthread_create(&workers[started], NULL, png_worker, &encoder) == 0)
+    ) {
+        started++;
+    }
+    uLong adler = adler32(0, Z_NULL, 0);
+    size_t written = 0;
+    const struct png_block_t* previous = NULL;
+    for(size_t b = 0; b < total_blocks; b++) {
+        // the block before in this slot of the ring must be written out first
+        if(b >= encoder.block_count) {
+            const struct png_block_t* done = finish_png_block(
+                &encoder, written++
+            );
+            ok = ok && write_png_block(&stream, done, &adler);
+        }
+        struct png_block_t* block = &encoder.blocks[b % encoder.block_count];
+        size_t rows = rasteriser->height - b * block_rows;
+        rows = (rows < block_rows) ? rows : block_rows;
+        for(size_t r = 0; r < rows; r++) {
+            uint8_t* scanline = block->input + r * scanline_size;
+            const uint8_t* row = next_raster_row(rasteriser);
+            scanline[0] = 0;
+            // PNG has 0 for black, the opposite of the rasteriser
+            for(size_t i = 0; i < rasteriser->row_size; i++) {
+                scanline[i + 1] = (uint8_t)~row[i];
+            }
+            // leave the padding at the end of the row clear
+            if(rasteriser->width % 8 != 0) {
+                scanline[rasteriser->row_size] &= (uint8_t)(
+                    0xff00u >> (rasteriser->width % 8)
+                );
+            }
+        }
+        block->input_size = rows * scanline_size;
+        block->dictionary_size = 0;
+        if(previous != NULL) {
+            block->dictionary_size = (
+                (previous->input_size < PNG_DICTIONARY_SIZE) ?
+                previous->input_size : PNG_DICTIONARY_SIZE
+            );
+            memcpy(
+                block->dictionary,
+                previous->input + previous->input_size - block->dictionary_size,
+                block->dictionary_size
+            );
+        }
+        block->first = (b == 0);
+        block->last = (b == total_blocks - 1);
+        block->done = false;
+        previous = block;
+        pthread_mutex_lock(&encoder.lock);
+        encoder.produced++;
+        pthread_cond_broadcast(&encoder.changed);
+        pthread_mutex_unlock(&encoder.lock);
+    }
+    pthread_mutex_lock(&encoder.lock);
+    encoder.finished = true;
+    pthread_cond_broadcast(&encoder.changed);
+    pthread_mutex_unlock(&encoder.lock);
+    // write out the blocks still in the ring, in order
+    while(written < total_blocks) {
+        const struct png_block_t* done = finish_png_block(&encoder, written++);
+        ok = ok && write_png_block(&stream, done, &adler);
+    }
+    for(size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    pthread_cond_destroy(&encoder.changed);
+    pthread_mutex_destroy(&encoder.lock);
+    free_png_blocks(&encoder);
+    // the zlib trailer gets an IDAT chunk of its own, then the image ends
+    uint8_t trailer[12 + 4 + 12];
+    store_uint32(trailer, 4);
+    memcpy(trailer + 4, "IDAT", 4);
+    store_uint32(trailer + 8, (uint32_t)adler);
+    store_uint32(trailer + 12, checksum(trailer + 4, 8));
+    store_uint32(trailer + 16, 0);
+    memcpy(trailer + 20, "IEND", 4);
+    store_uint32(trailer + 24, checksum(trailer + 20, 4));
+    ok = ok && write_output_stream(&stream, trailer, sizeof(trailer));
+    return close_output_stream(&stream, ok);
+}
+
+/*
+ * private function, renders the rasteriser's image in the given format to the
+ * file at the given path, or stdout if the path is "-". PNG images are
+ * deflated at the given zlib level, on as many threads as jobs says to.
+ * returns true on success and false on failure.
+ */
+static bool raster_to_path(
+    struct rasteriser_t* rasteriser, enum spiral_render_mode_t render_mode,
+    int png_level, int jobs, const char* file_path, bool direct
+) {
+    if(render_mode == RENDER_MODE_PNG) {
+        return raster_to_png(rasteriser, png_level, jobs, file_path, direct);
+    }
+    return raster_to_pbm(rasteriser, file_path, direct);
+}
+
+/*
+ * private function, renders the given outline as an image in the given format
+ * to the file at the given path, or stdout if the path is "-", as
+ * raster_to_path() does.
+ * returns true on success and false on failure.
+ */
+static bool outline_to_path(
+    const struct raster_outline_t* outline,
+    enum spiral_render_mode_t render_mode, int png_level, int jobs,
+    const char* file_path, bool direct
+) {
+    struct rasteriser_t rasteriser;
+    if(!start_rasteriser(&rasteriser, outline)) {
+        return false;
+    }
+    bool ok = raster_to_path(
+        &rasteriser, render_mode, png_level, jobs, file_path, direct
+    );
+    free_rasteriser(&rasteriser);
+    return ok;
+}
+
+/*
+ * private function, returns the file extension of the given path, including
+ * the dot, or the end of the path if there isn't one
+ */
+static const char* path_extension(const char* file_path) {
+    const char* extension = strrchr(file_path, '.');
+    const char* file_name = strrchr(file_path, '/');
+    if(
+        (extension == NULL) ||
+        ((file_name != NULL) && (extension < file_name))
+    ) {
+        extension = file_path + strlen(file_path);
+    }
+    return extension;
+}
+
+/*
+ * private function, returns the path of the file for the tile at the given
+ * column and row of an image to be written to the given path: the column and
+ * row are put just before the file extension, if there is one.
+ * returns NULL if memory couldn't be allocated for it.
+ */
+static char* tile_path(const char* file_path, uint32_t column, uint32_t row) {
+    const char* extension = path_extension(file_path);
+    size_t size = strlen(file_path) + 24;
+    char* path = malloc(size);
+    if(path != NULL) {
+        snprintf(
+            path, size, "%.*s.%" PRIu32 ".%" PRIu32 "%s",
+            (int)(extension - file_path), file_path, column, row, extension
+        );
+    }
+    return path;
+}
+
+/*
+ * private function, returns the path of the file for the given frame of a
+ * spiral's checkpoints written to the given path: the frame number is put just
+ * before the file extension, as tile_path() does, with enough leading zeros
+ * that the frames sort in order.
+ * returns NULL if memory couldn't be allocated for it.
+ */
+static char* frame_path(const char* file_path, unsigned long frame) {
+    const char* extension = path_extension(file_path);
+    size_t size = strlen(file_path) + 24;
+    char* path = malloc(size);
+    if(path != NULL) {
+        snprintf(
+            path, size, "%.*s.%06lu%s", (int)(extension - file_path),
+            file_path, frame, extension
+        );
+    }
+    return path;
+}
+
+/*
+ * private structure, the tiles of an image, shared between the threads
+ * rendering them
+ */
+struct tile_set_t {
+    const struct raster_outline_t* outline; // outline of the whole image
+    // window holding the whole image, which is used instead if not NULL
+    const struct raster_window_t* window;
+    uint32_t width; // width of the whole image
+    uint32_t height; // height of the whole image
+    enum spiral_render_mode_t render_mode; // whether to render to pbm or png
+    const char* file_path; // path the tile paths are made from
+    bool direct; // whether to write tiles with O_DIRECT
+    int png_level; // zlib level to deflate PNG tiles at
+    uint32_t tile_width; // width of each tile, apart from the last column
+    uint32_t tile_height; // height of each tile, apart from the last row
+    uint32_t columns; // number of columns of tiles
+    size_t count; // number of tiles
+    size_t next; // index of the next tile to render
+    size_t failed; // number of tiles which failed
+    pthread_mutex_t lock; // guards next and failed
+};
+
+/*
+ * private function, tile render thread entry point.
+ * renders tiles one after the other until there are none left.
+ */
+static void* tile_worker(void* tiles_void_pointer) {
+    struct tile_set_t* tiles = (struct tile_set_t*)tiles_void_pointer;
+    while(true) {
+        pthread_mutex_lock(&tiles->lock);
+        size_t index = tiles->next;
+        if(index < tiles->count) {
+            tiles->next++;
+        }
+        pthread_mutex_unlock(&tiles->lock);
+        if(index >= tiles->count) {
+            return NULL;
+        }
+        uint32_t column = (uint32_t)(index % tiles->columns);
+        uint32_t row = (uint32_t)(index / tiles->columns);
+        uint32_t left = column * tiles->tile_width;
+        uint32_t top = row * tiles->tile_height;
+        // tiles at the right and bottom edges are cut short
+        uint32_t width = tiles->width - left;
+        uint32_t height = tiles->height - top;
+        width = (width < tiles->tile_width) ? width : tiles->tile_width;
+        height = (height < tiles->tile_height) ? height : tiles->tile_height;
+        char* path = tile_path(tiles->file_path, column, row);
+        bool ok = (path != NULL);
+        // the tiles are already rendered in parallel, so each uses one thread
+        if(ok && (tiles->window != NULL)) {
+            struct raster_window_t window = *tiles->window;
+            window.left += left;
+            window.top += top;
+            window.width = width;
+            window.height = height;
+            struct rasteriser_t rasteriser;
+            ok = start_window_rasteriser(&rasteriser, &window);
+            if(ok) {
+                ok = raster_to_path(
+                    &rasteriser, tiles->render_mode, tiles->png_level, 1, path,
+                    tiles->direct
+                );
+                free_rasteriser(&rasteriser);
+            }
+        } else if(ok) {
+            struct raster_outline_t clipped;
+            ok = clip_raster_outline(
+                tiles->outline, left, top, width, height, &clipped
+            );
+            if(ok) {
+                ok = outline_to_path(
+                    &clipped, tiles->render_mode, tiles->png_level, 1, path,
+                    tiles->direct
+                );
+                free(clipped.segments);
+            }
+        }
+        if(!ok) {
+            fprintf(
+                stderr, "Couldn't render tile: %s\n",
+                (path != NULL) ? path : tiles->file_path
+            );
+            pthread_mutex_lock(&tiles->lock);
+            tiles->failed++;
+            pthread_mutex_unlock(&tiles->lock);
+        }
+        free(path);
+    }
+}
+
+/*
+ * private function, renders the given outline, or window if it isn't NULL, as
+ * a grid of tiles, each one to its own file, rendering as many at once as the
+ * view says to.
+ * returns true on success and false on failure.
+ */
+static bool render_tiles(
+    const struct raster_outline_t* outline,
+    const struct raster_window_t* window,
+    enum spiral_render_mode_t render_mode, const struct render_view_t* view,
+    const char* file_path, bool direct
+) {
+    uint32_t width = (window != NULL) ? window->width : outline->width;
+    uint32_t height = (window != NULL) ? window->height : outline->height;
+    uint32_t columns = (width - 1) / view->tile_width + 1;
+    uint32_t rows = (height - 1) / view->tile_height + 1;
+    struct tile_set_t tiles = {
+        .outline = outline,
+        .window = window,
+        .width = width,
+        .height = height,
+        .render_mode = render_mode,
+        .file_path = file_path,
+        .direct = direct,
+        .png_level = view->png_level,
+        .tile_width = view->tile_width,
+        .tile_height = view->tile_height,
+        .columns = columns,
+        .count = (size_t)columns * rows,
+        .next = 0,
+        .failed = 0,
+    };
+    // don't start more workers than there are tiles
+    size_t worker_count = (view->jobs < 1) ? 1 : (size_t)view->jobs;
+    worker_count = (worker_count < tiles.count) ? worker_count : tiles.count;
+    pthread_mutex_init(&tiles.lock, NULL);
+    // as with batches, the calling thread is one of the workers
+    pthread_t* workers = calloc(worker_count, sizeof(pthread_t));
+    size_t started = 0;
+    if(workers != NULL) {
+        while(
+            (started < worker_count - 1) &&
+            (pthread_create(&workers[started], NULL, tile_worker, &tiles) == 0)
+        ) {
+            started++;
+        }
+    }
+    tile_worker(&tiles);
+    for(size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    pthread_mutex_destroy(&tiles.lock);
+    return tiles.failed == 0;
+}
+
+/*
+ * private function, writes one relative move of an SVG path, going the given
+ * distance in pixels in the given direction, to the given output stream.
+ * returns true on success and false on failure.
+ */
+static bool write_svg_move(
+    struct output_stream_t* stream, sxbp_vector_t vector, int64_t distance
+) {
+    char move[32];
+    // SVG's y axis points down, the spiral's up
+    int size = snprintf(
+        move, sizeof(move), "%c%" PRId64, (vector.x != 0) ? 'h' : 'v',
+        ((vector.x != 0) ? vector.x : -vector.y) * distance
+    );
+    return write_output_stream(stream, move, (size_t)size);
+}
+
+/*
+ * private function, renders the solved lines of the given spiral, which has the
+ * given bounds, as an SVG image straight into the file at the given path, or
+ * stdout if the path is "-". it has the same layout as the raster images: the
+ * path runs through the middle of the pixels they'd ink, and the first line is
+ * dotted. runs of lines going the same way are merged into one move. nothing is
+ * held in memory but the move being written, however many lines there are.
+ * returns true on success and false on failure.
+ */
+static bool spiral_to_svg(
+    const sxbp_spiral_t* spiral, const struct spiral_bounds_t* bounds,
+    uint32_t scale, const char* file_path, bool direct
+) {
+    int64_t width = (bounds->max_x - bounds->min_x) * 2 + 3;
+    int64_t height = (bounds->max_y - bounds->min_y) * 2 + 3;
+    struct output_stream_t stream;
+    if(!open_output_stream(&stream, file_path, 0, direct)) {
+        return false;
+    }
+    // the view box puts the middle of each pixel on whole numbers
+    char text[512];
+    int size = snprintf(
+        text, sizeof(text),
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+        "width=\"%" PRId64 "\" height=\"%" PRId64 "\" "
+        "viewBox=\"-0.5 -0.5 %" PRId64 " %" PRId64 "\" "
+        "shape-rendering=\"crispEdges\">\n"
+        "<rect x=\"-0.5\" y=\"-0.5\" width=\"100%%\" height=\"100%%\" "
+        "fill=\"#fff\"/>\n"
+        "<g fill=\"none\" stroke=\"#000\" stroke-width=\"1\" "
+        "stroke-linecap=\"square\">\n"
+        "<path stroke-dasharray=\"0 2\" d=\"M%" PRId64 " %" PRId64,
+        (width + scale - 1) / scale, (height + scale - 1) / scale,
+        width, height,
+        -bounds->min_x * 2 + 1, bounds->max_y * 2 + 1
+    );
+    bool ok = write_output_stream(&stream, text, (size_t)size);
+    // the first line, with a dot for the origin and each whole co-ord after it
+    sxbp_vector_t vector = {1, 0};
+    int64_t distance = 0;
+    if(spiral->solved_count > 0) {
+        vector = SXBP_VECTOR_DIRECTIONS[spiral->lines[0].direction];
+        distance = (int64_t)spiral->lines[0].length * 2;
+    }
+    ok = ok && write_svg_move(&stream, vector, distance);
+    ok = ok && write_output_stream(&stream, "\"/>\n", 4);
+    // the rest of the lines, from where the first one ends
+    if(ok && (spiral->solved_count > 1)) {
+        size = snprintf(
+            text, sizeof(text), "<path d=\"M%" PRId64 " %" PRId64,
+            (vector.x * distance / 2 - bounds->min_x) * 2 + 1,
+            (bounds->max_y - vector.y * distance / 2) * 2 + 1
+        );
+        ok = write_output_stream(&stream, text, (size_t)size);
+        distance = 0;
+        for(uint32_t i = 1; ok && (i < spiral->solved_count); i++) {
+            sxbp_vector_t next = (
+                SXBP_VECTOR_DIRECTIONS[spiral->lines[i].direction]
+            );
+            if(spiral->lines[i].length == 0) {
+                continue;
+            }
+            // a line going the same way as the last just makes its move longer
+            if(
+                (distance > 0) &&
+                ((next.x != vector.x) || (next.y != vector.y))
+            ) {
+                ok = write_svg_move(&stream, vector, distance);
+                distance = 0;
+            }
+            vector = next;
+            distance += (int64_t)spiral->lines[i].length * 2;
+        }
+        if(ok && (distance > 0)) {
+            ok = write_svg_move(&stream, vector, distance);
+        }
+        ok = ok && write_output_stream(&stream, "\"/>\n", 4);
+    }
+    ok = ok && write_output_stream(&stream, "</g>\n</svg>\n", 12);
+    return close_output_stream(&stream, ok);
+}
+
+/*
+ * private function, writes the given spiral to the file at the given path, or
+ * stdout if the path is "-", in the given format, rendering images as laid out
+ * by the given view. images are rendered by sxbp's own rasteriser, except for
+ * SVGs, which are written straight from the lines. v2 sxp files record the
+ * given perfection schedule, unless it's NULL. the given geometry, which may
+ * be NULL, saves working out the bounds if it knows them and is stored in v2
+ * sxp files if it says to be. the time taken is recorded in stats, unless it
+ * is NULL.
+ * returns true on success and false on failure.
+ */
+static bool spiral_to_path(
+    const sxbp_spiral_t* spiral, const char* schedule,
+    const struct spiral_geometry_t* geometry,
+    enum spiral_render_mode_t render_mode, const struct render_view_t* view,
+    const char* file_path, bool direct, struct run_stats_t* stats
+) {
+    if(is_sxp_render_mode(render_mode)) {
+        sxbp_buffer_t buffer = {0, 0};
+        size_t capacity = 0;
+        begin_phase(stats);
+        bool ok = serialise_spiral(
+            *spiral, render_mode, schedule, geometry, &buffer, &capacity
+        );
+        end_phase(stats, PHASE_SERIALISE);
+        if(ok) {
+            begin_phase(stats);
+            ok = buffer_to_path(&buffer, file_path, direct);
+            end_phase(stats, PHASE_WRITE);
+        }
+        free_serialised(&buffer, capacity);
+        return ok;
+    }
+    // rendering and writing are done together, count it all as writing
+    begin_phase(stats);
+    struct spiral_bounds_t bounds = spiral_bounds(spiral, geometry);
+    if(render_mode == RENDER_MODE_SVG) {
+        bool ok = spiral_to_svg(
+            spiral, &bounds, view->scale, file_path, direct
+        );
+        end_phase(stats, PHASE_WRITE);
+        return ok;
+    }
+    struct raster_outline_t outline;
+    bool ok = trace_raster_outline(spiral, &bounds, view->scale, &outline);
+    if(ok) {
+        if(view->tile_width > 0) {
+            ok = render_tiles(
+                &outline, NULL, render_mode, view, file_path, direct
+            );
+        } else {
+            ok = outline_to_path(
+                &outline, render_mode, view->png_level, view->jobs, file_path,
+                direct
+            );
+        }
+        free(outline.segments);
+    }
+    end_phase(stats, PHASE_WRITE);
+    return ok;
+}
+
+// least room the canvas leaves on each side for a spiral to grow, in pixels
+#define CANVAS_MARGIN 64
+// most memory a canvas may take up, images bigger than it are traced afresh
+#define CANVAS_MAX_SIZE (64 * 1024 * 1024)
+
+/*
+ * private structure, an image of a spiral kept in memory from one checkpoint
+ * to the next, so that each checkpoint only has to draw the lines solved since
+ * the one before it, and rub out those the solver has gone back and changed.
+ * it leaves room all round for the spiral to grow into, and is only drawn
+ * again from scratch when the spiral outgrows it. images are cut out of it
+ * laid out just as trace_raster_outline() lays them out.
+ */
+struct render_canvas_t {
+    uint32_t scale; // the image is this many times smaller than full size
+    bool too_big; // whether the spiral has got too big to keep a canvas of
+    sxbp_line_t* lines; // copy of the lines drawn on the canvas
+    sxbp_co_ord_t* ends; // co-ord each line drawn ends at
+    uint32_t line_count; // number of lines drawn
+    uint32_t capacity; // number of lines there's memory allocated for
+    struct spiral_bounds_t bounds; // bounds of the lines drawn
+    int64_t left; // x co-ord of the canvas's left edge, at twice scale
+    int64_t top; // y co-ord of the canvas's top edge, at twice scale
+    uint32_t width; // width of the canvas in pixels
+    uint32_t height; // height of the canvas in pixels
+    size_t row_size; // size of a row in bytes
+    uint8_t* pixels; // rows of pixels, packed as the rasteriser's are
+};
+
+// private function, frees the memory allocated for a canvas and blanks it
+static void free_canvas(struct render_canvas_t* canvas) {
+    free(canvas->lines);
+    free(canvas->ends);
+    free(canvas->pixels);
+    memset(canvas, 0, sizeof(struct render_canvas_t));
+}
+
+/*
+ * private function, works out the pixels of the canvas covered by the line
+ * drawn on it at the given index, as trace_raster_outline() does, or by the
+ * pixel at the origin if the index is UINT32_MAX
+ */
+static struct raster_segment_t canvas_segment(
+    const struct render_canvas_t* canvas, uint32_t index
+) {
+    // pixel co-ords of a point in the spiral at twice scale
+    #define CANVAS_COLUMN(X) ((uint32_t)(((X) - canvas->left) / canvas->scale))
+    #define CANVAS_ROW(Y) ((uint32_t)((canvas->top - (Y)) / canvas->scale))
+    struct raster_segment_t segment = {
+        CANVAS_ROW(0), CANVAS_ROW(0), CANVAS_COLUMN(0), CANVAS_COLUMN(0), 1,
+    };
+    if(index == UINT32_MAX) {
+        return segment;
+    }
+    sxbp_co_ord_t start = {0, 0};
+    if(index > 0) {
+        start = canvas->ends[index - 1];
+    }
+    sxbp_co_ord_t end = canvas->ends[index];
+    sxbp_vector_t vector = SXBP_VECTOR_DIRECTIONS[
+        canvas->lines[index].direction
+    ];
+    int64_t step = (index == 0) ? 2 : 1;
+    uint32_t start_column = CANVAS_COLUMN(start.x * 2 + vector.x * step);
+    uint32_t start_row = CANVAS_ROW(start.y * 2 + vector.y * step);
+    uint32_t end_column = CANVAS_COLUMN(end.x * 2);
+    uint32_t end_row = CANVAS_ROW(end.y * 2);
+    #undef CANVAS_COLUMN
+    #undef CANVAS_ROW
+    segment.first_row = (start_row < end_row) ? start_row : end_row;
+    segment.last_row = (start_row < end_row) ? end_row : start_row;
+    segment.first_column = (
+        (start_column < end_column) ? start_column : end_column
+    );
+    segment.last_column = (
+        (start_column < end_column) ? end_column : start_column
+    );
+    segment.step = (canvas->scale == 1) ? (uint32_t)step : 1;
+    return segment;
+}
+
+// private function, inks or clears the pixels of a segment on the canvas
+static void paint_canvas_segment(
+    struct render_canvas_t* canvas, const struct raster_segment_t* segment,
+    bool ink
+) {
+    // segments are only ever one row or one column, so only one loop repeats
+    for(uint32_t row = segment->first_row;; row += segment->step) {
+        uint8_t* pixels = canvas->pixels + (size_t)row * canvas->row_size;
+        if(ink && (segment->step == 1)) {
+            fill_raster_span(
+                pixels, segment->first_column, segment->last_column
+            );
+        } else {
+            uint32_t column = segment->first_column;
+            for(;; column += segment->step) {
+                uint8_t bit = (uint8_t)(0x80u >> (column % 8));
+                pixels[column / 8] = (uint8_t)(
+                    ink ? (pixels[column / 8] | bit) :
+                    (pixels[column / 8] & ~bit)
+                );
+                if(segment->last_column - column < segment->step) {
+                    break;
+                }
+            }
+        }
+        if(segment->last_row - row < segment->step) {
+            break;
+        }
+    }
+}
+
+/*
+ * private function, returns whether the boxes around two segments of pixels
+ * overlap
+ */
+static bool raster_segments_meet(
+    const struct raster_segment_t* a, const struct raster_segment_t* b
+) {
+    return (
+        (a->last_row >= b->first_row) && (a->first_row <= b->last_row) &&
+        (a->last_column >= b->first_column) &&
+        (a->first_column <= b->last_column)
+    );
+}
+
+/*
+ * private function, rubs out the lines drawn on the canvas from the given
+ * index on, then draws again any of the lines before it which share pixels
+ * with them
+ */
+static void rub_out_canvas_lines(
+    struct render_canvas_t* canvas, uint32_t first
+) {
+    struct raster_segment_t rubbed = {UINT32_MAX, 0, UINT32_MAX, 0, 1};
+    uint32_t count = (canvas->pixels != NULL) ? canvas->line_count : first;
+    for(uint32_t i = first; i < count; i++) {
+        if(canvas->lines[i].length == 0) {
+            continue;
+        }
+        struct raster_segment_t segment = canvas_segment(canvas, i);
+        paint_canvas_segment(canvas, &segment, false);
+        // keep track of the box around all the pixels rubbed out
+        rubbed.first_row = (
+            (segment.first_row < rubbed.first_row) ?
+            segment.first_row : rubbed.first_row
+        );
+        rubbed.last_row = (
+            (segment.last_row > rubbed.last_row) ?
+            segment.last_row : rubbed.last_row
+        );
+        rubbed.first_column = (
+            (segment.first_column < rubbed.first_column) ?
+            segment.first_column : rubbed.first_column
+        );
+        rubbed.last_column = (
+            (segment.last_column > rubbed.last_column) ?
+            segment.last_column : rubbed.last_column
+        );
+    }
+    canvas->line_count = first;
+    // the bounds may have shrunk along with the spiral
+    canvas->bounds = (struct spiral_bounds_t){0, 0, 0, 0};
+    for(uint32_t i = 0; i < first; i++) {
+        sxbp_co_ord_t end = canvas->ends[i];
+        struct spiral_bounds_t* bounds = &canvas->bounds;
+        bounds->min_x = (end.x < bounds->min_x) ? end.x : bounds->min_x;
+        bounds->max_x = (end.x > bounds->max_x) ? end.x : bounds->max_x;
+        bounds->min_y = (end.y < bounds->min_y) ? end.y : bounds->min_y;
+        bounds->max_y = (end.y > bounds->max_y) ? end.y : bounds->max_y;
+    }
+    if((canvas->pixels == NULL) || (rubbed.first_row > rubbed.last_row)) {
+        return;
+    }
+    // only lines which cross the box can have lost any of their pixels
+    struct raster_segment_t origin = canvas_segment(canvas, UINT32_MAX);
+    if(raster_segments_meet(&origin, &rubbed)) {
+        paint_canvas_segment(canvas, &origin, true);
+    }
+    for(uint32_t i = 0; i < first; i++) {
+        if(canvas->lines[i].length == 0) {
+            continue;
+        }
+        struct raster_segment_t segment = canvas_segment(canvas, i);
+        if(raster_segments_meet(&segment, &rubbed)) {
+            paint_canvas_segment(canvas, &segment, true);
+        }
+    }
+}
+
+/*
+ * private function, works out the window of the canvas that the image of the
+ * lines drawn on it is in.
+ * returns false if any of the image is off the edge of the canvas, or its
+ * pixels don't line up with the canvas's, which can happen when the spiral
+ * grows and the image is scaled down. either way, the canvas must be made
+ * afresh.
+ */
+static bool canvas_window(
+    const struct render_canvas_t* canvas, struct raster_window_t* window
+) {
+    const struct spiral_bounds_t* bounds = &canvas->bounds;
+    int64_t scale = canvas->scale;
+    int64_t left = bounds->min_x * 2 - 1 - canvas->left;
+    int64_t top = canvas->top - (bounds->max_y * 2 + 1);
+    int64_t width = (
+        ((bounds->max_x - bounds->min_x) * 2 + 3 + scale - 1) / scale
+    );
+    int64_t height = (
+        ((bounds->max_y - bounds->min_y) * 2 + 3 + scale - 1) / scale
+    );
+    if(
+        (canvas->pixels == NULL) || (left < 0) || (top < 0) ||
+        (left % scale != 0) || (top % scale != 0) ||
+        (left / scale + width > canvas->width) ||
+        (top / scale + height > canvas->height)
+    ) {
+        return false;
+    }
+    *window = (struct raster_window_t){
+        .pixels = canvas->pixels,
+        .row_size = canvas->row_size,
+        .left = (uint32_t)(left / scale),
+        .top = (uint32_t)(top / scale),
+        .width = (uint32_t)width,
+        .height = (uint32_t)height,
+    };
+    return true;
+}
+
+/*
+ * private function, makes the canvas afresh around the lines drawn on it, with
+ * half as much room again as they take up on each side for them to grow into,
+ * or none if that would be too big, and draws all of them on it.
+ * returns true on success and false on failure.
+ */
+static bool remake_canvas(struct render_canvas_t* canvas) {
+    free(canvas->pixels);
+    canvas->pixels = NULL;
+    const struct spiral_bounds_t* bounds = &canvas->bounds;
+    int64_t scale = canvas->scale;
+    int64_t width = (bounds->max_x - bounds->min_x) * 2 + 3;
+    int64_t height = (bounds->max_y - bounds->min_y) * 2 + 3;
+    for(int64_t room = 1; room >= 0; room--) {
+        // margins are in whole pixels, so that pixels line up with the image's
+        int64_t margin_x = room * (width / 2 / scale + CANVAS_MARGIN);
+        int64_t margin_y = room * (height / 2 / scale + CANVAS_MARGIN);
+        int64_t columns = (width + scale - 1) / scale + margin_x * 2;
+        int64_t rows = (height + scale - 1) / scale + margin_y * 2;
+        int64_t row_size = (columns + 7) / 8;
+        if(
+            (columns > (int64_t)UINT32_MAX) || (rows > (int64_t)UINT32_MAX) ||
+            (row_size > CANVAS_MAX_SIZE / rows)
+        ) {
+            continue;
+        }
+        canvas->left = bounds->min_x * 2 - 1 - margin_x * scale;
+        canvas->top = bounds->max_y * 2 + 1 + margin_y * scale;
+        canvas->width = (uint32_t)columns;
+        canvas->height = (uint32_t)rows;
+        canvas->row_size = (size_t)row_size;
+        canvas->pixels = calloc((size_t)rows, (size_t)row_size);
+        if(canvas->pixels == NULL) {
+            return false;
+        }
+        struct raster_segment_t origin = canvas_segment(canvas, UINT32_MAX);
+        paint_canvas_segment(canvas, &origin, true);
+        for(uint32_t i = 0; i < canvas->line_count; i++) {
+            if(canvas->lines[i].length > 0) {
+                struct raster_segment_t segment = canvas_segment(canvas, i);
+                paint_canvas_segment(canvas, &segment, true);
+            }
+        }
+        return true;
+    }
+    canvas->too_big = true;
+    return false;
+}
+
+/*
+ * private function, brings the canvas up to date with the solved lines of the
+ * given spiral, rendered at the given scale, and sets window to where the image
+ * of them is in the canvas. lines the solver has changed since they were drawn
+ * are rubbed out, then the rest of the lines solved since are drawn.
+ * returns false if the canvas can't be kept, for want of memory or because the
+ * spiral has got too big for one, in which case the image has to be traced
+ * from scratch instead.
+ */
+static bool update_canvas(
+    struct render_canvas_t* canvas, const sxbp_spiral_t* spiral,
+    uint32_t scale, struct raster_window_t* window
+) {
+    if(canvas->too_big) {
+        return false;
+    }
+    if(canvas->scale != scale) {
+        free_canvas(canvas);
+        canvas->scale = scale;
+    }
+    // the lines before the first that's changed are drawn already
+    uint32_t kept = 0;
+    while(
+        (kept < canvas->line_count) && (kept < spiral->solved_count) &&
+        (canvas->lines[kept].direction == spiral->lines[kept].direction) &&
+        (canvas->lines[kept].length == spiral->lines[kept].length)
+    ) {
+        kept++;
+    }
+    if(kept < canvas->line_count) {
+        rub_out_canvas_lines(canvas, kept);
+    }
+    if(canvas->capacity < spiral->solved_count) {
+        sxbp_line_t* lines = realloc(
+            canvas->lines, spiral->solved_count * sizeof(sxbp_line_t)
+        );
+        canvas->lines = (lines != NULL) ? lines : canvas->lines;
+        sxbp_co_ord_t* ends = realloc(
+            canvas->ends, spiral->solved_count * sizeof(sxbp_co_ord_t)
+        );
+        canvas->ends = (ends != NULL) ? ends : canvas->ends;
+        if((lines == NULL) || (ends == NULL)) {
+            free_canvas(canvas);
+            return false;
+        }
+        canvas->capacity = spiral->solved_count;
+    }
+    sxbp_co_ord_t at = {0, 0};
+    if(kept > 0) {
+        at = canvas->ends[kept - 1];
+    }
+    struct spiral_bounds_t* bounds = &canvas->bounds;
+    for(uint32_t i = kept; i < spiral->solved_count; i++) {
+        sxbp_line_t line = spiral->lines[i];
+        sxbp_vector_t vector = SXBP_VECTOR_DIRECTIONS[line.direction];
+        at.x += vector.x * line.length;
+        at.y += vector.y * line.length;
+        canvas->lines[i] = line;
+        canvas->ends[i] = at;
+        bounds->min_x = (at.x < bounds->min_x) ? at.x : bounds->min_x;
+        bounds->max_x = (at.x > bounds->max_x) ? at.x : bounds->max_x;
+        bounds->min_y = (at.y < bounds->min_y) ? at.y : bounds->min_y;
+        bounds->max_y = (at.y > bounds->max_y) ? at.y : bounds->max_y;
+    }
+    canvas->line_count = spiral->solved_count;
+    if(!canvas_window(canvas, window)) {
+        if(!remake_canvas(canvas)) {
+            // remember it's too big, so as not to go through the lines again
+            bool too_big = canvas->too_big;
+            free_canvas(canvas);
+            canvas->too_big = too_big;
+            return false;
+        }
+        return canvas_window(canvas, window);
+    }
+    for(uint32_t i = kept; i < spiral->solved_count; i++) {
+        if(canvas->lines[i].length > 0) {
+            struct raster_segment_t segment = canvas_segment(canvas, i);
+            paint_canvas_segment(canvas, &segment, true);
+        }
+    }
+    return true;
+}
+
+/*
+ * private function, renders the image in the given window in the given format
+ * to the file at the given path, laid out as the view says to.
+ * returns true on success and false on failure.
+ */
+static bool window_to_path(
+    const struct raster_window_t* window,
+    enum spiral_render_mode_t render_mode, const struct render_view_t* view,
+    const char* file_path, bool direct
+) {
+    if(view->tile_width > 0) {
+        return render_tiles(NULL, window, render_mode, view, file_path, direct);
+    }
+    struct rasteriser_t rasteriser;
+    if(!start_window_rasteriser(&rasteriser, window)) {
+        return false;
+    }
+    bool ok = raster_to_path(
+        &rasteriser, render_mode, view->png_level, view->jobs, file_path,
+        direct
+    );
+    free_rasteriser(&rasteriser);
+    return ok;
+}
+
+// most outputs one run can write
+#define MAX_OUTPUTS 16
+
+/*
+ * private structure, the outputs of a run which writes more than one, shared
+ * between the threads encoding them
+ */
+struct output_set_t {
+    const sxbp_spiral_t* spiral; // spiral to write out
+    const char* schedule; // perfection schedule to record with it, or NULL
+    // its geometry, with the bounds known, to store in v2 sxp files if asked
+    const struct spiral_geometry_t* geometry;
+    const struct spiral_bounds_t* bounds; // bounds of its solved lines
+    // its pixels as laid out by the view, if any outputs are raster images
+    const struct raster_outline_t* outline;
+    const struct render_view_t* view; // how to lay out images
+    const char* const* file_paths; // paths of the files to write
+    const enum spiral_render_mode_t* render_modes; // format of each file
+    size_t count; // number of outputs
+    bool direct; // whether to write outputs with O_DIRECT
+    // what stdin and stdout stand for on the thread which started the workers
+    const sxbp_buffer_t* standard_input;
+    sxbp_buffer_t* standard_output;
+    size_t next; // index of the next output to write
+    size_t failed; // number of outputs which failed
+    pthread_mutex_t lock; // guards next and failed
+};
+
+/*
+ * private function, output encoder thread entry point.
+ * writes outputs one after the other until there are none left.
+ */
+static void* output_worker(void* outputs_void_pointer) {
+    struct output_set_t* outputs = (struct output_set_t*)outputs_void_pointer;
+    // a daemon job's stdout is the same whichever thread writes to it
+    set_standard_buffers(outputs->standard_input, outputs->standard_output);
+    while(true) {
+        pthread_mutex_lock(&outputs->lock);
+        size_t index = outputs->next;
+        if(index < outputs->count) {
+            outputs->next++;
+        }
+        pthread_mutex_unlock(&outputs->lock);
+        if(index >= outputs->count) {
+            return NULL;
+        }
+        const char* file_path = outputs->file_paths[index];
+        enum spiral_render_mode_t render_mode = outputs->render_modes[index];
+        bool ok = false;
+        if(is_sxp_render_mode(render_mode)) {
+            sxbp_buffer_t buffer = {0, 0};
+            size_t capacity = 0;
+            ok = (
+                serialise_spiral(
+                    *outputs->spiral, render_mode, outputs->schedule,
+                    outputs->geometry, &buffer, &capacity
+                ) &&
+                buffer_to_path(&buffer, file_path, outputs->direct)
+            );
+            free_serialised(&buffer, capacity);
+        } else if(render_mode == RENDER_MODE_SVG) {
+            ok = spiral_to_svg(
+                outputs->spiral, outputs->bounds, outputs->view->scale,
+                file_path, outputs->direct
+            );
+        } else if(outputs->view->tile_width > 0) {
+            ok = render_tiles(
+                outputs->outline, NULL, render_mode, outputs->view, file_path,
+                outputs->direct
+            );
+        } else {
+            ok = outline_to_path(
+                outputs->outline, render_mode, outputs->view->png_level,
+                outputs->view->jobs, file_path, outputs->direct
+            );
+        }
+        if(!ok) {
+            fprintf(stderr, "Couldn't write output file: %s\n", file_path);
+            pthread_mutex_lock(&outputs->lock);
+            outputs->failed++;
+            pthread_mutex_unlock(&outputs->lock);
+        }
+    }
+}
+
+/*
+ * private function, writes the given spiral to each of the given paths in the
+ * format given for it, as spiral_to_path() does for one. the geometry they
+ * share, the bounds and the pixels of the raster images, is worked out once,
+ * then the outputs are each encoded on a thread of their own, as many at once
+ * as the view says to. the time taken is recorded in stats, unless it is NULL.
+ * returns true on success and false on failure.
+ */
+static bool spiral_to_paths(
+    const sxbp_spiral_t* spiral, const char* schedule,
+    const struct spiral_geometry_t* geometry,
+    const enum spiral_render_mode_t* render_modes,
+    const struct render_view_t* view, const char* const* file_paths,
+    size_t count, bool direct, struct run_stats_t* stats
+) {
+    begin_phase(stats);
+    struct spiral_geometry_t known_geometry = {
+        .store = (geometry != NULL) && geometry->store, .known = true,
+        .bounds = spiral_bounds(spiral, geometry),
+    };
+    const struct spiral_bounds_t bounds = known_geometry.bounds;
+    struct raster_outline_t outline = {0, 0, NULL, 0};
+    bool ok = true;
+    for(size_t i = 0; ok && (i < count); i++) {
+        if(
+            !is_sxp_render_mode(render_modes[i]) &&
+            (render_modes[i] != RENDER_MODE_SVG)
+        ) {
+            ok = trace_raster_outline(spiral, &bounds, view->scale, &outline);
+            break;
+        }
+    }
+    struct output_set_t outputs = {
+        .spiral = spiral,
+        .schedule = schedule,
+        .geometry = &known_geometry,
+        .bounds = &bounds,
+        .outline = &outline,
+        .view = view,
+        .file_paths = file_paths,
+        .render_modes = render_modes,
+        .count = count,
+        .direct = direct,
+        .standard_input = standard_input_buffer(),
+        .standard_output = standard_output_buffer(),
+        .next = 0,
+        .failed = 0,
+    };
+    if(ok) {
+        // don't start more workers than there are outputs
+        size_t worker_count = (view->jobs < 1) ? 1 : (size_t)view->jobs;
+        worker_count = (worker_count < count) ? worker_count : count;
+        pthread_mutex_init(&outputs.lock, NULL);
+        // as with tiles, the calling thread is one of the workers
+        pthread_t* workers = calloc(worker_count, sizeof(pthread_t));
+        size_t started = 0;
+        if(workers != NULL) {
+            while(
+                (started < worker_count - 1) &&
+                (pthread_create(
+                    &workers[started], NULL, output_worker, &outputs
+                ) == 0)
+            ) {
+                started++;
+            }
+        }
+        output_worker(&outputs);
+        for(size_t i = 0; i < started; i++) {
+            pthread_join(workers[i], NULL);
+        }
+        free(workers);
+        pthread_mutex_destroy(&outputs.lock);
+        ok = (outputs.failed == 0);
+    }
+    free(outline.segments);
+    end_phase(stats, PHASE_WRITE);
+    return ok;
+}
+
+/*
+ * private structure, a copy of the state of a spiral at a checkpoint, which has
+ * its own copy of the lines so that the solver can carry on changing them
+ */
+struct spiral_snapshot_t {
+    sxbp_spiral_t spiral; // copy of the spiral, with lines pointing to our own
+    uint32_t capacity; // number of lines there is memory allocated for
+    char* schedule; // perfection schedule the lines were solved with, or NULL
+    char* schedule_text; // memory for the schedule, reused by each snapshot
+    size_t schedule_capacity; // number of bytes allocated for schedule_text
+    unsigned long schedule_changes; // the schedule's changes as of the text
+};
+
+/*
+ * private function, copies the state of a spiral into a snapshot, reusing the
+ * memory already allocated for the snapshot's lines if there's enough of it.
+ * returns true on success, false on failure.
+ */
+static bool take_snapshot(
+    const sxbp_spiral_t* spiral, struct spiral_snapshot_t* snapshot
+) {
+    sxbp_line_t* lines = snapshot->spiral.lines;
+    if(snapshot->capacity < spiral->size) {
+        lines = realloc(lines, spiral->size * sizeof(sxbp_line_t));
+        if(lines == NULL) {
+            return false;
+        }
+        snapshot->capacity = spiral->size;
+    }
+    memcpy(lines, spiral->lines, spiral->size * sizeof(sxbp_line_t));
+    // copy all the other fields as they are, except for the co-ord cache
+    snapshot->spiral = *spiral;
+    snapshot->spiral.lines = lines;
+    snapshot->spiral.co_ord_cache = sxbp_blank_spiral().co_ord_cache;
+    return true;
+}
+
+// the magic number at the start of every journal file
+#define JOURNAL_MAGIC "SXBPJRNL"
+// the size of the journal magic number, without a terminating NUL
+#define JOURNAL_MAGIC_SIZE 8
+// version of the journal format, written after the magic number
+#define JOURNAL_VERSION 1
+/*
+ * size of the journal header: magic number, version, then the size and CRC-32
+ * of the spiral file the journal is to be applied to
+ */
+#define JOURNAL_HEADER_SIZE (JOURNAL_MAGIC_SIZE + 2 + 8 + 4)
+/*
+ * size of the fixed part of a journal record: the index of the first line in
+ * the record, the count of lines in it and the spiral's solved count after it.
+ * these are followed by the lines, then a CRC-32 of all that came before.
+ */
+#define JOURNAL_RECORD_HEADER_SIZE 12
+
+/*
+ * private function, returns the path of the journal file which goes with the
+ * spiral file at the given path, allocated with malloc()
+ */
+static char* journal_path(const char* spiral_path) {
+    size_t size = strlen(spiral_path) + sizeof(".sxj");
+    char* path = malloc(size);
+    if(path != NULL) {
+        snprintf(path, size, "%s.sxj", spiral_path);
+    }
+    return path;
+}
+
+/*
+ * private function, writes the header of a new, empty journal which goes with
+ * the given serialised spiral into a buffer
+ */
+static void journal_header(
+    const sxbp_buffer_t* base, uint8_t header[JOURNAL_HEADER_SIZE]
+) {
+    memcpy(header, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE);
+    header[JOURNAL_MAGIC_SIZE] = (uint8_t)(JOURNAL_VERSION >> 8);
+    header[JOURNAL_MAGIC_SIZE + 1] = (uint8_t)JOURNAL_VERSION;
+    uint64_t base_size = (uint64_t)base->size;
+    store_uint32(header + JOURNAL_MAGIC_SIZE + 2, (uint32_t)(base_size >> 32));
+    store_uint32(header + JOURNAL_MAGIC_SIZE + 6, (uint32_t)base_size);
+    store_uint32(
+        header + JOURNAL_MAGIC_SIZE + 10, checksum(base->bytes, base->size)
+    );
+}
+
+/*
+ * private function, replays the journal at the given path onto a spiral loaded
+ * from the given serialised spiral, if the journal was written for it.
+ * a missing journal or one for a different spiral file is not an error, nor is
+ * a damaged record at the end of the journal, replay just stops before it.
+ * returns true on success, false on failure.
+ */
+static bool apply_journal(
+    const char* path, sxbp_buffer_t base, sxbp_spiral_t* spiral
+) {
+    FILE* journal_file = fopen(path, "rb");
+    if(journal_file == NULL) {
+        // no journal, so nothing to do
+        return true;
+    }
+    sxbp_buffer_t journal = {0, 0};
+    bool read_ok = file_to_buffer(journal_file, &journal);
+    fclose(journal_file);
+    if(!read_ok) {
+        fprintf(stderr, "Couldn't read journal file: %s\n", path);
+        return false;
+    }
+    // check the journal was written for this spiral file
+    uint8_t expected_header[JOURNAL_HEADER_SIZE];
+    journal_header(&base, expected_header);
+    if(
+        (journal.size < JOURNAL_HEADER_SIZE) ||
+        (memcmp(journal.bytes, expected_header, JOURNAL_HEADER_SIZE) != 0)
+    ) {
+        fprintf(
+            stderr, "Journal doesn't match spiral file, ignoring: %s\n", path
+        );
+        free(journal.bytes);
+        return true;
+    }
+    // replay each record in turn
+    size_t offset = JOURNAL_HEADER_SIZE;
+    while(offset < journal.size) {
+        const uint8_t* record = journal.bytes + offset;
+        size_t remaining = journal.size - offset;
+        if(remaining < JOURNAL_RECORD_HEADER_SIZE) {
+            break;
+        }
+        uint32_t start = load_uint32(record);
+        uint32_t count = load_uint32(record + 4);
+        uint32_t solved_count = load_uint32(record + 8);
+        size_t record_size = JOURNAL_RECORD_HEADER_SIZE + 4 * (size_t)count;
+        if(
+            (count > spiral->size) || (start > spiral->size - count) ||
+            (solved_count > spiral->size) || (remaining < record_size + 4) ||
+            (checksum(record, record_size) != load_uint32(record + record_size))
+        ) {
+            break;
+        }
+        for(uint32_t i = 0; i < count; i++) {
+            spiral->lines[start + i] = unpack_line(
+                load_uint32(record + JOURNAL_RECORD_HEADER_SIZE + 4 * i)
+            );
+        }
+        spiral->solved_count = solved_count;
+        offset += record_size + 4;
+    }
+    if(offset < journal.size) {
+        fprintf(
+            stderr, "Ignoring damaged end of journal at byte %zu: %s\n",
+            offset, path
+        );
+    }
+    free(journal.bytes);
+    return true;
+}
+
+/*
+ * private structure, a background thread which writes checkpoints of a spiral
+ * to file while the solver carries on.
+ * three snapshots are rotated between the solver and the writer: the solver
+ * fills one and swaps it with the pending one, which the writer then swaps with
+ * the one it's writing. if the writer falls behind, the pending snapshot is
+ * replaced by a newer one and never written, so the solver never has to wait.
+ */
+struct checkpoint_writer_t {
+    // whether to save to sxp, pbm or png format
+    enum spiral_render_mode_t render_mode;
+    const struct render_view_t* view; // how to lay out images
+    const char* file_path; // path of file to save to
+    // geometry to save v2 sxp files with, which only ever says whether to
+    struct spiral_geometry_t geometry;
+    // image of the last checkpoint, which the next one is drawn on
+    struct render_canvas_t canvas;
+    bool frames; // whether each checkpoint is written to a file of its own
+    unsigned long frame_count; // number of frames written so far
+    struct spiral_snapshot_t snapshots[3]; // memory for the three snapshots
+    struct spiral_snapshot_t* filling; // snapshot owned by the solver
+    struct spiral_snapshot_t* pending; // snapshot waiting to be written
+    struct spiral_snapshot_t* writing; // snapshot owned by the writer
+    bool has_pending; // whether the pending snapshot is newer than the last
+    bool stopping; // whether the writer has been asked to stop
+    /*
+     * in journal mode, the path of the journal file to append checkpoints to,
+     * otherwise NULL
+     */
+    char* journal_path;
+    FILE* journal_file; // journal file, open for appending
+    size_t journal_size; // size of journal file so far
+    size_t base_size; // size of the spiral file the journal goes with
+    // state of the spiral as of the last checkpoint written in journal mode
+    struct spiral_snapshot_t journaled;
+    bool threaded; // whether the writer thread is running
+    pthread_mutex_t lock; // guards pending, has_pending and stopping
+    pthread_cond_t wake; // signalled when has_pending or stopping change
+    pthread_t thread;
+};
+
+/*
+ * private function, starts a new journal for the given snapshot: writes the
+ * whole spiral to the writer's file, then replaces the journal with an empty
+ * one for that file.
+ * returns true on success, false on failure.
+ */
+static bool restart_journal(
+    struct checkpoint_writer_t* writer, struct spiral_snapshot_t* snapshot
+) {
+    if(writer->journal_file != NULL) {
+        fclose(writer->journal_file);
+        writer->journal_file = NULL;
+    }
+    sxbp_buffer_t base = {0, 0};
+    size_t capacity = 0;
+    bool ok = serialise_spiral(
+        snapshot->spiral, writer->render_mode, snapshot->schedule,
+        &writer->geometry, &base, &capacity
+    );
+    ok = ok && buffer_to_path(&base, writer->file_path, false);
+    if(ok) {
+        uint8_t header[JOURNAL_HEADER_SIZE];
+        journal_header(&base, header);
+        sxbp_buffer_t header_buffer = {header, JOURNAL_HEADER_SIZE};
+        ok = buffer_to_path(&header_buffer, writer->journal_path, false);
+        writer->base_size = base.size;
+        writer->journal_size = JOURNAL_HEADER_SIZE;
+    }
+    free_serialised(&base, capacity);
+    if(ok) {
+        writer->journal_file = fopen(writer->journal_path, "ab");
+        ok = (writer->journal_file != NULL);
+    }
+    return ok && take_snapshot(&snapshot->spiral, &writer->journaled);
+}
+
+/*
+ * private function, appends the lines which have changed since the last
+ * checkpoint to the journal as one record.
+ * the solver backtracks, so lines before the previous checkpoint may have
+ * changed too, the record starts from the first line that differs.
+ * returns true on success, false on failure.
+ */
+static bool append_journal_record(
+    struct checkpoint_writer_t* writer, struct spiral_snapshot_t* snapshot
+) {
+    sxbp_spiral_t* previous = &writer->journaled.spiral;
+    sxbp_spiral_t* latest = &snapshot->spiral;
+    // find the first line that's different from last time
+    uint32_t start = 0;
+    while(
+        (start < previous->solved_count) && (start < latest->solved_count) &&
+        (pack_line(previous->lines[start]) == pack_line(latest->lines[start]))
+    ) {
+        start++;
+    }
+    if(
+        (start == latest->solved_count) &&
+        (previous->solved_count == latest->solved_count)
+    ) {
+        // nothing has changed
+        return true;
+    }
+    uint32_t count = latest->solved_count - start;
+    size_t record_size = JOURNAL_RECORD_HEADER_SIZE + 4 * (size_t)count;
+    // records come and go with every checkpoint, so they're pooled
+    size_t record_capacity = 0;
+    uint8_t* record = acquire_buffer(record_size + 4, &record_capacity);
+    if(record == NULL) {
+        return false;
+    }
+    store_uint32(record, start);
+    store_uint32(record + 4, count);
+    store_uint32(record + 8, latest->solved_count);
+    for(uint32_t i = 0; i < count; i++) {
+        store_uint32(
+            record + JOURNAL_RECORD_HEADER_SIZE + 4 * i,
+            pack_line(latest->lines[start + i])
+        );
+    }
+    store_uint32(record + record_size, checksum(record, record_size));
+    // append and make sure the record is on disk
+    bool ok = (
+        (fwrite(record, 1, record_size + 4, writer->journal_file) ==
+         record_size + 4) &&
+        (fflush(writer->journal_file) == 0) &&
+        (fsync(fileno(writer->journal_file)) == 0)
+    );
+    release_buffer(record, record_capacity);
+    if(ok) {
+        writer->journal_size += record_size + 4;
+        // bring our copy up to date, only the changed lines need copying
+        memcpy(
+            previous->lines + start, latest->lines + start,
+            count * sizeof(sxbp_line_t)
+        );
+        previous->solved_count = latest->solved_count;
+    }
+    return ok;
+}
+
+/*
+ * private function, saves a snapshot in journal mode.
+ * usually this appends only what's changed to the journal, but the first time
+ * and whenever the journal has grown bigger than the spiral file, the whole
+ * spiral is written out and the journal started again.
+ */
+static void journal_snapshot(
+    struct checkpoint_writer_t* writer, struct spiral_snapshot_t* snapshot
+) {
+    bool ok = false;
+    if(
+        (writer->journal_file == NULL) ||
+        (writer->journal_size > writer->base_size)
+    ) {
+        ok = restart_journal(writer, snapshot);
+    } else {
+        ok = append_journal_record(writer, snapshot);
+        if(!ok) {
+            // the journal may be damaged now, so start afresh next time
+            fclose(writer->journal_file);
+            writer->journal_file = NULL;
+        }
+    }
+    if(!ok) {
+        fprintf(
+            stderr, "Couldn't write checkpoint to journal: %s\n",
+            writer->journal_path
+        );
+    }
+}
+
+/*
+ * private function, serialises the given snapshot and writes it to the
+ * writer's file, or the file for the next frame if writing frames, reporting
+ * any errors on stderr. images are drawn on the writer's canvas, so only the
+ * lines changed since the last checkpoint have to be drawn.
+ */
+static void write_snapshot(
+    struct checkpoint_writer_t* writer, struct spiral_snapshot_t* snapshot
+) {
+    if(writer->journal_path != NULL) {
+        journal_snapshot(writer, snapshot);
+        return;
+    }
+    char* frame = NULL;
+    if(writer->frames) {
+        frame = frame_path(writer->file_path, writer->frame_count++);
+        if(frame == NULL) {
+            fprintf(stderr, "%s\n", "Couldn't allocate memory for checkpoint");
+            return;
+        }
+    }
+    const char* file_path = (frame != NULL) ? frame : writer->file_path;
+    struct raster_window_t window;
+    bool ok = false;
+    if(
+        (
+            (writer->render_mode == RENDER_MODE_PBM) ||
+            (writer->render_mode == RENDER_MODE_PNG)
+        ) &&
+        update_canvas(
+            &writer->canvas, &snapshot->spiral, writer->view->scale, &window
+        )
+    ) {
+        ok = window_to_path(
+            &window, writer->render_mode, writer->view, file_path, false
+        );
+    } else {
+        ok = spiral_to_path(
+            &snapshot->spiral, snapshot->schedule, &writer->geometry,
+            writer->render_mode, writer->view, file_path, false, NULL
+        );
+    }
+    if(!ok) {
+        fprintf(stderr, "Couldn't write checkpoint to file: %s\n", file_path);
+    }
+    free(frame);
+}
+
+/*
+ * private function, checkpoint writer thread entry point.
+ * writes each snapshot that's submitted until asked to stop, writing the last
+ * one it was given before stopping if it hasn't already.
+ */
+static void* checkpoint_writer_thread(void* writer_void_pointer) {
+    struct checkpoint_writer_t* writer = (
+        (struct checkpoint_writer_t*)writer_void_pointer
+    );
+    pthread_mutex_lock(&writer->lock);
+    while(true) {
+        while(!writer->has_pending && !writer->stopping) {
+            pthread_cond_wait(&writer->wake, &writer->lock);
+        }
+        if(!writer->has_pending) {
+            // we're stopping and there's nothing left to write
+            break;
+        }
+        // take the pending snapshot and write it without holding the lock
+        struct spiral_snapshot_t* snapshot = writer->pending;
+        writer->pending = writer->writing;
+        writer->writing = snapshot;
+        writer->has_pending = false;
+        pthread_mutex_unlock(&writer->lock);
+        write_snapshot(writer, writer->writing);
+        pthread_mutex_lock(&writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+/*
+ * private function, initialises a checkpoint writer and starts its thread.
+ * if the thread can't be started, checkpoints are written synchronously.
+ * store_geometry is whether v2 sxp checkpoints store the spiral's geometry,
+ * which is worked out for each one as snapshots don't have it. frames is
+ * whether each checkpoint is written to a numbered file of its own.
+ */
+static void start_checkpoint_writer(
+    struct checkpoint_writer_t* writer,
+    enum spiral_render_mode_t render_mode, const struct render_view_t* view,
+    const char* file_path, bool journal, bool store_geometry, bool frames
+) {
+    writer->render_mode = render_mode;
+    writer->view = view;
+    writer->file_path = file_path;
+    writer->geometry = (struct spiral_geometry_t){
+        .store = store_geometry, .known = false,
+        .bounds = {0, 0, 0, 0},
+    };
+    memset(&writer->canvas, 0, sizeof(struct render_canvas_t));
+    writer->frames = frames;
+    writer->frame_count = 0;
+    writer->journal_path = journal ? journal_path(file_path) : NULL;
+    writer->journal_file = NULL;
+    writer->journal_size = 0;
+    writer->base_size = 0;
+    writer->journaled.spiral = sxbp_blank_spiral();
+    writer->journaled.capacity = 0;
+    writer->journaled.schedule = NULL;
+    writer->journaled.schedule_text = NULL;
+    for(size_t i = 0; i < 3; i++) {
+        writer->snapshots[i].spiral = sxbp_blank_spiral();
+        writer->snapshots[i].capacity = 0;
+        writer->snapshots[i].schedule = NULL;
+        writer->snapshots[i].schedule_text = NULL;
+        writer->snapshots[i].schedule_capacity = 0;
+        writer->snapshots[i].schedule_changes = 0;
+    }
+    writer->filling = &writer->snapshots[0];
+    writer->pending = &writer->snapshots[1];
+    writer->writing = &writer->snapshots[2];
+    writer->has_pending = false;
+    writer->stopping = false;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->wake, NULL);
+    writer->threaded = (
+        pthread_create(
+            &writer->thread, NULL, checkpoint_writer_thread, writer
+        ) == 0
+    );
+}
+
+/*
+ * private function, sets a snapshot's schedule to the text of the given one, or
+ * NULL if that's NULL or empty. the text is only written again when the
+ * schedule has changed since, into memory kept by the snapshot, so taking
+ * checkpoints with a schedule that's settled doesn't allocate anything.
+ * returns true on success, false if memory couldn't be allocated.
+ */
+static bool snapshot_schedule(
+    struct spiral_snapshot_t* snapshot,
+    const struct perfection_schedule_t* schedule
+) {
+    if((schedule == NULL) || (schedule->count == 0)) {
+        snapshot->schedule = NULL;
+        return true;
+    }
+    if(
+        (snapshot->schedule != NULL) &&
+        (snapshot->schedule_changes == schedule->changes)
+    ) {
+        return true;
+    }
+    size_t size = schedule_text_size(schedule);
+    if(snapshot->schedule_capacity < size) {
+        char* text = realloc(snapshot->schedule_text, size);
+        if(text == NULL) {
+            snapshot->schedule = NULL;
+            return false;
+        }
+        snapshot->schedule_text = text;
+        snapshot->schedule_capacity = size;
+    }
+    write_schedule(schedule, snapshot->schedule_text, size);
+    snapshot->schedule = snapshot->schedule_text;
+    snapshot->schedule_changes = schedule->changes;
+    return true;
+}
+
+/*
+ * private function, submits the current state of a spiral to be written by a
+ * checkpoint writer, with the perfection schedule it's being solved with if
+ * that's not NULL. only the lines and schedule are copied here, all
+ * serialisation and file I/O happens on the writer's thread.
+ */
+static void submit_checkpoint(
+    struct checkpoint_writer_t* writer, const sxbp_spiral_t* spiral,
+    const struct perfection_schedule_t* schedule
+) {
+    if(
+        !take_snapshot(spiral, writer->filling) ||
+        !snapshot_schedule(writer->filling, schedule)
+    ) {
+        fprintf(stderr, "%s\n", "Couldn't allocate memory for checkpoint");
+        return;
+    }
+    if(!writer->threaded) {
+        write_snapshot(writer, writer->filling);
+        return;
+    }
+    // publish our snapshot as the pending one, replacing any not yet written
+    pthread_mutex_lock(&writer->lock);
+    struct spiral_snapshot_t* snapshot = writer->pending;
+    writer->pending = writer->filling;
+    writer->filling = snapshot;
+    writer->has_pending = true;
+    pthread_cond_signal(&writer->wake);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+/*
+ * private function, stops a checkpoint writer, waiting for it to write the last
+ * checkpoint submitted, then frees its memory
+ */
+static void stop_checkpoint_writer(struct checkpoint_writer_t* writer) {
+    if(writer->threaded) {
+        pthread_mutex_lock(&writer->lock);
+        writer->stopping = true;
+        pthread_cond_signal(&writer->wake);
+        pthread_mutex_unlock(&writer->lock);
+        pthread_join(writer->thread, NULL);
+    }
+    pthread_cond_destroy(&writer->wake);
+    pthread_mutex_destroy(&writer->lock);
+    for(size_t i = 0; i < 3; i++) {
+        free(writer->snapshots[i].spiral.lines);
+        free(writer->snapshots[i].schedule_text);
+    }
+    if(writer->journal_file != NULL) {
+        fclose(writer->journal_file);
+    }
+    free(writer->journal_path);
+    free(writer->journaled.spiral.lines);
+    free_canvas(&writer->canvas);
+}
+
+// private enumeration, what a run is asked to do before it plots each line
+enum stop_request_t {
+    STOP_NONE, // carry on
+    STOP_CANCEL, // stop and throw the work away
+    STOP_SAVE, // stop and write out the progress made so far
+};
+
+/*
+ * private structure, the requests made of the program by signals. they're
+ * caught by a thread of their own, see handle_signals(), so it's only ever
+ * read and written with its lock held like any other shared state.
+ */
+struct signal_requests_t {
+    bool stop; // whether SIGINT or SIGTERM has been caught
+    unsigned long checkpoints; // number of times SIGUSR1 has been caught
+    pthread_mutex_t lock;
+};
+
+static struct signal_requests_t signal_requests = {
+    .stop = false, .checkpoints = 0, .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// whether handle_signals() has been called, only set before any threads start
+static bool signals_handled = false;
+
+/*
+ * private function, entry point of the thread which catches the signals asking
+ * runs to stop or take a checkpoint. a second signal to stop after the first
+ * one kills the program there and then, for when stopping takes too long.
+ */
+static void* signal_thread(void* signals_void_pointer) {
+    sigset_t* signals = (sigset_t*)signals_void_pointer;
+    while(true) {
+        int signal_number;
+        if(sigwait(signals, &signal_number) != 0) {
+            continue;
+        }
+        pthread_mutex_lock(&signal_requests.lock);
+        bool stopping = signal_requests.stop;
+        if(signal_number == SIGUSR1) {
+            signal_requests.checkpoints++;
+        } else {
+            signal_requests.stop = true;
+        }
+        pthread_mutex_unlock(&signal_requests.lock);
+        if((signal_number != SIGUSR1) && stopping) {
+            // let the signal do what it would've done if we hadn't caught it
+            sigset_t unblock;
+            sigemptyset(&unblock);
+            sigaddset(&unblock, signal_number);
+            signal(signal_number, SIG_DFL);
+            pthread_sigmask(SIG_UNBLOCK, &unblock, NULL);
+            raise(signal_number);
+        } else if(signal_number != SIGUSR1) {
+            fprintf(
+                stderr, "%s\n",
+                "Stopping at the next line, send the signal again to quit now"
+            );
+        }
+    }
+    return NULL;
+}
+
+/*
+ * private function, starts catching SIGINT and SIGTERM to stop runs gracefully
+ * and SIGUSR1 to take a checkpoint. must be called before any other threads
+ * are started, so that they all inherit the signals being blocked and only the
+ * signal thread ever sees them.
+ * returns true on success, false on failure.
+ */
+static bool handle_signals(void) {
+    static sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    if(pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0) {
+        return false;
+    }
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, signal_thread, &signals) != 0) {
+        pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+        return false;
+    }
+    pthread_detach(thread);
+    signals_handled = true;
+    return true;
+}
+
+// private function, returns whether a signal has asked runs to stop
+static bool stop_signalled(void) {
+    pthread_mutex_lock(&signal_requests.lock);
+    bool stop = signal_requests.stop;
+    pthread_mutex_unlock(&signal_requests.lock);
+    return stop;
+}
+
+/*
+ * private function, returns whether a signal has asked for a checkpoint since
+ * the given count of them was last updated, and updates it
+ */
+static bool checkpoint_signalled(unsigned long* seen) {
+    pthread_mutex_lock(&signal_requests.lock);
+    bool signalled = (signal_requests.checkpoints != *seen);
+    *seen = signal_requests.checkpoints;
+    pthread_mutex_unlock(&signal_requests.lock);
+    return signalled;
+}
+
+// private function, returns the resident set size of the process in KiB now
+static long current_rss_kib(void) {
+#ifdef __linux__
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if(statm != NULL) {
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        int count = fscanf(statm, "%lu %lu", &size, &resident);
+        fclose(statm);
+        long page_size = sysconf(_SC_PAGESIZE);
+        if((count == 2) && (page_size > 0)) {
+            return (long)(resident * ((unsigned long)page_size / 1024));
+        }
+    }
+#endif
+    // elsewhere, the peak is the closest we can get
+    return peak_rss_kib();
+}
+
+// how often in seconds a run with a memory budget checks how much it's using
+#define RSS_CHECK_INTERVAL 0.1
+
+/*
+ * private structure, the limits a run stops generating at, checked before each
+ * line. every spiral of a sharded run shares it, so everything which changes is
+ * guarded by the lock.
+ */
+struct run_limits_t {
+    // the run's own should_stop function and its context, if it has one
+    enum stop_request_t (*should_stop)(void* context);
+    void* stop_context;
+    double deadline; // monotonic clock time to stop at, if > 0
+    long max_rss_kib; // resident set size to stop at, if > 0
+    double next_rss_check; // monotonic clock time to next check memory at
+    bool stopped; // whether a limit or signal has stopped the run
+    pthread_mutex_t lock;
+};
+
+/*
+ * private function, starts the limits of a run which has the given deadline
+ * in seconds and memory budget in MiB (neither is used if <= 0), wrapping the
+ * given should_stop function
+ */
+static void start_run_limits(
+    struct run_limits_t* limits, int deadline, int max_rss,
+    enum stop_request_t (*should_stop)(void* context), void* stop_context
+) {
+    double now = clock_seconds(CLOCK_MONOTONIC);
+    limits->should_stop = should_stop;
+    limits->stop_context = stop_context;
+    limits->deadline = (deadline > 0) ? now + deadline : 0.0;
+    limits->max_rss_kib = (max_rss > 0) ? (long)max_rss * 1024 : 0;
+    limits->next_rss_check = now;
+    limits->stopped = false;
+    pthread_mutex_init(&limits->lock, NULL);
+}
+
+/*
+ * private function, should_stop function of runs with limits. a run which is
+ * out of time or memory, or has been asked to stop by a signal, keeps what
+ * it's done so far.
+ */
+static enum stop_request_t check_run_limits(void* limits_void_pointer) {
+    struct run_limits_t* limits = (struct run_limits_t*)limits_void_pointer;
+    // the run's own reason to stop, such as being cancelled, comes first
+    if(limits->should_stop != NULL) {
+        enum stop_request_t request = limits->should_stop(limits->stop_context);
+        if(request != STOP_NONE) {
+            return request;
+        }
+    }
+    const char* reason = NULL;
+    double now = clock_seconds(CLOCK_MONOTONIC);
+    pthread_mutex_lock(&limits->lock);
+    bool stopped = limits->stopped;
+    bool check_rss = (
+        (limits->max_rss_kib > 0) && (now >= limits->next_rss_check)
+    );
+    if(check_rss) {
+        limits->next_rss_check = now + RSS_CHECK_INTERVAL;
+    }
+    pthread_mutex_unlock(&limits->lock);
+    if(stopped) {
+        return STOP_SAVE;
+    } else if(stop_signalled()) {
+        reason = "Interrupted";
+    } else if((limits->deadline > 0) && (now >= limits->deadline)) {
+        reason = "Deadline reached";
+    } else if(check_rss && (current_rss_kib() >= limits->max_rss_kib)) {
+        reason = "Memory budget reached";
+    } else {
+        return STOP_NONE;
+    }
+    // only say why once, however many spirals the run is making
+    pthread_mutex_lock(&limits->lock);
+    stopped = limits->stopped;
+    limits->stopped = true;
+    pthread_mutex_unlock(&limits->lock);
+    if(!stopped) {
+        fprintf(stderr, "%s, stopping early\n", reason);
+    }
+    return STOP_SAVE;
+}
+
+/*
+ * private structure, used for supplying many a datum to the callback function
+ * passed to plot_spiral()
+ */
+struct user_data_t {
+    uint32_t save_line_interval; // save file every this number of lines, if > 0
+    // writer to hand checkpoints to, NULL if not saving checkpoints
+    struct checkpoint_writer_t* writer;
+    struct run_stats_t* stats; // statistics to update, NULL if not collecting
+    unsigned long checkpoint_signals; // checkpoints asked for by signals so far
+    // perfection schedule to save with checkpoints, NULL if there isn't one
+    const struct perfection_schedule_t* schedule;
+};
+
+/*
+ * disable GCC warning about the unused parameter, as this is a callback it must
+ * include all arguments specified by the library prototype, even if not used
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+/*
+ * private function - callback handler for plot_spiral()
+ * records statistics on the solve if collecting them, and hands the current
+ * spiral state to the checkpoint writer, to be saved to .sxp or an image
+ * depending on whether in render mode or not, depending on how often it is to
+ * save output
+ */
+static void plot_spiral_callback(
+    sxbp_spiral_t* spiral, uint32_t latest_line, uint32_t target_line,
+    void* user_data_void_pointer
+) {
+    // cast void pointer to our user data type
+    struct user_data_t* user_data = (struct user_data_t*)user_data_void_pointer;
+    if(user_data->stats != NULL) {
+        record_solved_line(user_data->stats, spiral);
+    }
+    // check if we need to save this time, or have been asked to by a signal
+    if(
+        (user_data->writer != NULL) &&
+        (
+            (
+                (user_data->save_line_interval > 0) &&
+                (
+                    ((spiral->solved_count - 1) %
+                    user_data->save_line_interval) == 0
+                )
+            ) ||
+            checkpoint_signalled(&user_data->checkpoint_signals)
+        )
+    ) {
+        submit_checkpoint(user_data->writer, spiral, user_data->schedule);
+    }
+}
+// re-enable all warnings
+#pragma GCC diagnostic pop
+
+/*
+ * private structure, holds all of the options which configure one run of the
+ * program, that is, the processing of one input into one output
+ */
+struct run_options_t {
+    bool prepare; // whether to prepare a spiral from raw binary data
+    bool generate; // whether to generate the lengths of the spiral's lines
+    bool render; // whether to render the spiral to an image
+    bool perfect; // whether the perfection threshold is enabled
+    int perfect_threshold; // optimisation threshold to use if enabled
+    int line_limit; // plot this many more lines than currently solved
+    int total_lines; // total number of lines to plot to
+    int save_every; // save to file every this number of lines solved
+    bool journal; // whether to journal checkpoints instead of rewriting them
+    bool resume; // whether to replay the input spiral's journal when loading
+    const char* image_format; // which image format to render to (pbm/png/svg)
+    const char* sxp_format; // which format to write sxp files in (v1/v2/v2z)
+    bool store_geometry; // whether to store the geometry in v2 sxp files
+    bool frames; // whether to write each checkpoint to a file of its own
+    const char* input_string; // string to use as input data, if given
+    const char* input_file_path; // path of file to read input from, if given
+    const char* output_file_path; // path of file to write output to
+    // paths of more files to write output to, each in the format it's named as
+    const char* const* extra_output_paths;
+    int extra_output_count; // number of extra output paths
+    const char* stats_file_path; // path to write statistics to, if given
+    int progress_interval; // print progress every this many seconds if > 0
+    bool direct_io; // whether to write the output with O_DIRECT if possible
+    struct render_view_t view; // how to lay out rendered images
+    const char* cache_dir; // directory to cache solved spirals in, if given
+    int cache_size; // most the cache can take up, in MiB
+    int shard_size; // split the input into chunks this big if > 0
+    int deadline; // stop generating after this many seconds if > 0
+    int max_rss; // stop generating once using this many MiB if > 0
+    // adapt the perfection threshold to generate in this many seconds if > 0
+    int target_time;
+    const char* schedule; // perfection schedule to generate with, if given
+    // if not NULL, asked between lines whether to stop generating early
+    enum stop_request_t (*should_stop)(void* context);
+    void* stop_context; // passed to should_stop
+};
+
+/*
+ * private function, frees the memory allocated by libsxbp for the given spiral
+ * and resets it to a blank spiral
+ */
+static void free_spiral(sxbp_spiral_t* spiral) {
+    free(spiral->lines);
+    free(spiral->co_ord_cache.co_ords.items);
+    *spiral = sxbp_blank_spiral();
+}
+
+/*
+ * size of a cache key as a string: a 64-bit FNV-1a hash of the input and the
+ * settings that affect the solution, then a CRC-32 of the input, both in hex
+ */
+#define CACHE_KEY_SIZE (16 + 8 + 1)
+
+// private enumeration, the outcomes of looking for a spiral in the cache
+enum cache_result_t {
+    CACHE_MISS, // nothing useful in the cache
+    CACHE_PARTIAL_HIT, // the spiral was found, solved to fewer lines
+    CACHE_HIT, // the spiral was found, solved to the wanted number of lines
+};
+
+// names of the cache results, as used in the statistics file
+static const char* const CACHE_RESULT_NAMES[] = {"miss", "partial", "hit"};
+
+/*
+ * private function, works out the cache key for a spiral made from the given
+ * input buffer. everything which changes how the spiral is solved goes into
+ * it: the input, whether it's raw data or an sxp file, the perfection
+ * threshold or the schedule of them if not NULL and the version of libsxbp
+ * doing the solving.
+ */
+static void make_cache_key(
+    sxbp_buffer_t input_buffer, bool prepare, int perfection,
+    const char* schedule, char key[CACHE_KEY_SIZE]
+) {
+    uint8_t settings[1 + 4 + 8];
+    settings[0] = prepare ? 1 : 0;
+    store_uint32(settings + 1, (uint32_t)perfection);
+    store_uint32(settings + 5, (uint32_t)((uint64_t)input_buffer.size >> 32));
+    store_uint32(settings + 9, (uint32_t)input_buffer.size);
+    uint64_t hash = 0xcbf29ce484222325u;
+    hash = fnv1a_64(
+        hash, LIB_SXBP_VERSION.string, strlen(LIB_SXBP_VERSION.string) + 1
+    );
+    hash = fnv1a_64(hash, settings, sizeof(settings));
+    if(schedule != NULL) {
+        hash = fnv1a_64(hash, schedule, strlen(schedule) + 1);
+    }
+    hash = fnv1a_64(hash, input_buffer.bytes, input_buffer.size);
+    snprintf(
+        key, CACHE_KEY_SIZE, "%016" PRIx64 "%08" PRIx32, hash,
+        checksum(input_buffer.bytes, input_buffer.size)
+    );
+}
+
+/*
+ * private function, returns the path of the cache entry with the given key for
+ * a spiral solved to the given number of lines.
+ * returns NULL if memory couldn't be allocated for it.
+ */
+static char* cache_entry_path(
+    const char* cache_dir, const char* key, uint32_t target_line
+) {
+    size_t size = strlen(cache_dir) + CACHE_KEY_SIZE + 32;
+    char* path = malloc(size);
+    if(path != NULL) {
+        snprintf(
+            path, size, "%s/%s-%" PRIu32 ".sxp", cache_dir, key, target_line
+        );
+    }
+    return path;
+}
+
+/*
+ * private function, if the given file name is that of a cache entry, stores
+ * the number of lines it's solved to in target_line.
+ * if key is not NULL, only entries with that key count.
+ * returns true if it's a cache entry, false if not.
+ */
+static bool parse_cache_entry_name(
+    const char* file_name, const char* key, uint32_t* target_line
+) {
+    size_t key_length = CACHE_KEY_SIZE - 1;
+    if(
+        (strlen(file_name) <= key_length + 1) ||
+        ((key != NULL) && (strncmp(file_name, key, key_length) != 0)) ||
+        (file_name[key_length] != '-')
+    ) {
+        return false;
+    }
+    const char* digits = file_name + key_length + 1;
+    if((*digits < '0') || (*digits > '9')) {
+        return false;
+    }
+    char* end = NULL;
+    unsigned long long value = strtoull(digits, &end, 10);
+    if((strcmp(end, ".sxp") != 0) || (value > UINT32_MAX)) {
+        return false;
+    }
+    *target_line = (uint32_t)value;
+    return true;
+}
+
+/*
+ * private function, looks in the cache for the given spiral solved to the given
+ * number of lines, or if it's not there, solved to as many lines as possible
+ * short of that. if found, the spiral is replaced with it.
+ * returns whether it was found and whether it was solved as far as wanted.
+ */
+static enum cache_result_t fetch_cached_spiral(
+    const char* cache_dir, const char* key, uint32_t target_line,
+    sxbp_spiral_t* spiral
+) {
+    DIR* directory = opendir(cache_dir);
+    if(directory == NULL) {
+        return CACHE_MISS;
+    }
+    // find the entry solved furthest without going past the target
+    uint32_t best_line = 0;
+    bool found = false;
+    struct dirent* entry;
+    while((entry = readdir(directory)) != NULL) {
+        uint32_t entry_line;
+        if(
+            parse_cache_entry_name(entry->d_name, key, &entry_line) &&
+            (entry_line <= target_line) &&
+            (entry_line > spiral->solved_count) &&
+            (!found || (entry_line > best_line))
+        ) {
+            best_line = entry_line;
+            found = true;
+        }
+    }
+    closedir(directory);
+    if(!found) {
+        return CACHE_MISS;
+    }
+    char* path = cache_entry_path(cache_dir, key, best_line);
+    if(path == NULL) {
+        return CACHE_MISS;
+    }
+    struct input_buffer_t input;
+    sxbp_spiral_t cached = sxbp_blank_spiral();
+    bool ok = path_to_input(path, &input);
+    if(ok) {
+        sxbp_serialise_result_t result = load_spiral(
+            input.buffer, &cached, false, NULL, NULL
+        );
+        free_input(&input);
+        ok = (result.status == SXBP_OPERATION_OK);
+    }
+    if(ok) {
+        // this is the most recently used entry now
+        utimensat(AT_FDCWD, path, NULL, 0);
+        free_spiral(spiral);
+        *spiral = cached;
+    } else {
+        // it's damaged or someone else just evicted it, either way it's no use
+        fprintf(stderr, "Ignoring unreadable cache entry: %s\n", path);
+        free_spiral(&cached);
+    }
+    free(path);
+    if(!ok) {
+        return CACHE_MISS;
+    }
+    return (best_line == target_line) ? CACHE_HIT : CACHE_PARTIAL_HIT;
+}
+
+// private structure, a file in the cache directory, for eviction
+struct cache_file_t {
+    char* path; // path of the file
+    off_t size; // size of the file in bytes
+    struct timespec used; // when the file was last used
+};
+
+// private function, for sorting cache files from least to most recently used
+static int compare_cache_files(const void* a, const void* b) {
+    const struct timespec* a_used = &((const struct cache_file_t*)a)->used;
+    const struct timespec* b_used = &((const struct cache_file_t*)b)->used;
+    if(a_used->tv_sec != b_used->tv_sec) {
+        return (a_used->tv_sec > b_used->tv_sec) ? 1 : -1;
+    }
+    return (
+        (a_used->tv_nsec > b_used->tv_nsec) -
+        (a_used->tv_nsec < b_used->tv_nsec)
+    );
+}
+
+/*
+ * private function, removes the least recently used entries in the cache until
+ * it takes up no more than the given number of bytes.
+ * other processes may be using the cache at the same time, so entries which
+ * vanish while we're at it are skipped over.
+ */
+static void evict_cache_entries(const char* cache_dir, uint64_t max_size) {
+    DIR* directory = opendir(cache_dir);
+    if(directory == NULL) {
+        return;
+    }
+    struct cache_file_t* files = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    uint64_t total_size = 0;
+    struct dirent* entry;
+    while((entry = readdir(directory)) != NULL) {
+        uint32_t target_line;
+        if(!parse_cache_entry_name(entry->d_name, NULL, &target_line)) {
+            continue;
+        }
+        if(count == capacity) {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            struct cache_file_t* grown = realloc(
+                files, capacity * sizeof(struct cache_file_t)
+            );
+            if(grown == NULL) {
+                break;
+            }
+            files = grown;
+        }
+        size_t path_size = strlen(cache_dir) + strlen(entry->d_name) + 2;
+        char* path = malloc(path_size);
+        struct stat status;
+        if(path == NULL) {
+            break;
+        }
+        snprintf(path, path_size, "%s/%s", cache_dir, entry->d_name);
+        if(stat(path, &status) != 0) {
+            free(path);
+            continue;
+        }
+        files[count].path = path;
+        files[count].size = status.st_size;
+        files[count].used = status.st_mtim;
+        total_size += (uint64_t)status.st_size;
+        count++;
+    }
+    closedir(directory);
+    if(total_size > max_size) {
+        qsort(files, count, sizeof(struct cache_file_t), compare_cache_files);
+        for(size_t i = 0; (i < count) && (total_size > max_size); i++) {
+            remove(files[i].path);
+            total_size -= (uint64_t)files[i].size;
+        }
+    }
+    for(size_t i = 0; i < count; i++) {
+        free(files[i].path);
+    }
+    free(files);
+}
+
+/*
+ * private function, saves the given spiral in the cache as solved to the given
+ * number of lines, then evicts old entries to keep the cache within max_size.
+ * failing to save isn't an error, the work just isn't cached.
+ */
+static void store_cached_spiral(
+    const char* cache_dir, const char* key, uint32_t target_line,
+    const sxbp_spiral_t* spiral, uint64_t max_size
+) {
+    // make the cache directory the first time it's used
+    if((mkdir(cache_dir, 0777) != 0) && (errno != EEXIST)) {
+        fprintf(stderr, "Couldn't create cache directory: %s\n", cache_dir);
+        return;
+    }
+    char* path = cache_entry_path(cache_dir, key, target_line);
+    sxbp_buffer_t buffer = {0, 0};
+    size_t capacity = 0;
+    if(
+        (path == NULL) ||
+        // entries are compressed, they're only ever read by sxbp itself
+        !serialise_spiral(
+            *spiral, RENDER_MODE_SXP_V2_COMPRESSED, NULL, NULL, &buffer,
+            &capacity
+        ) ||
+        !buffer_to_path(&buffer, path, false)
+    ) {
+        fprintf(stderr, "%s\n", "Couldn't save spiral to cache");
+    }
+    free_serialised(&buffer, capacity);
+    free(path);
+    evict_cache_entries(cache_dir, max_size);
+}
+
+/*
+ * private function, plots the spiral's lines up to max_line like
+ * sxbp_plot_spiral(), which it calls with the same callback and user data.
+ * if the options have a should_stop function, the lines are plotted one at a
+ * time and it's asked before each whether to stop, in which case stopped is
+ * set to what it asked for. libsxbp keeps all the state of the solve in the
+ * spiral, so plotting it in steps gives the same result as plotting it in one
+ * go, and stopping between any two lines leaves a valid partial solution.
+ * returns the status of the last call to sxbp_plot_spiral().
+ */
+static sxbp_status_t plot_spiral(
+    const struct run_options_t* options, sxbp_spiral_t* spiral,
+    int perfection, uint32_t max_line,
+    void(* progress_callback)(
+        sxbp_spiral_t* spiral, uint32_t latest_line, uint32_t target_line,
+        void* progress_data
+    ),
+    void* progress_data, enum stop_request_t* stopped
+) {
+    *stopped = STOP_NONE;
+    if(options->should_stop == NULL) {
+        return sxbp_plot_spiral(
+            spiral, perfection, max_line, progress_callback, progress_data
+        );
+    }
+    uint32_t last_line = (max_line < spiral->size) ? max_line : spiral->size;
+    while(spiral->solved_count < last_line) {
+        *stopped = options->should_stop(options->stop_context);
+        if(*stopped != STOP_NONE) {
+            return SXBP_OPERATION_OK;
+        }
+        uint32_t solved_count = spiral->solved_count;
+        sxbp_status_t result = sxbp_plot_spiral(
+            spiral, perfection, solved_count + 1,
+            progress_callback, progress_data
+        );
+        // a solver that can't make progress would otherwise keep us here
+        if(
+            (result != SXBP_OPERATION_OK) ||
+            (spiral->solved_count == solved_count)
+        ) {
+            return result;
+        }
+    }
+    return SXBP_OPERATION_OK;
+}
+
+/*
+ * perfection thresholds a target time steps between, from fastest to slowest.
+ * the higher the threshold, the more optimisation the solver is allowed to do
+ * and the longer solving takes, and with it disabled (-1), as -D does, there's
+ * no limit at all, which is slowest.
+ */
+static const int SCHEDULE_LEVELS[] = {
+    1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, -1,
+};
+// number of perfection thresholds a time budget steps between
+#define SCHEDULE_LEVEL_COUNT (sizeof(SCHEDULE_LEVELS) / sizeof(int))
+// number of segments the lines solved to a time budget are split into
+#define SCHEDULE_SEGMENTS 32
+
+/*
+ * private function, returns how much work solving the lines from start up to
+ * but not including end takes, relative to other lines of the same spiral.
+ * each line has to be checked against all those before it, so the work grows
+ * with the line's index.
+ */
+static double schedule_work(uint32_t start, uint32_t end) {
+    return ((double)end - start) * ((double)start + end + 1) / 2;
+}
+
+/*
+ * private function, plots the spiral's lines up to max_line as plot_spiral()
+ * does, but with the perfection threshold of each line set by a schedule.
+ * if the options have a target time, the schedule is made as the lines are
+ * solved, and added to the given one: they're split into segments, and after
+ * each the rate they're being solved at is measured and the threshold stepped
+ * to the next quicker of SCHEDULE_LEVELS if the rest won't be done in time at
+ * that rate, or back to the next slower if they'll be done in under half the
+ * time. it starts at, and never goes slower than, the given perfection
+ * threshold. otherwise, the given schedule is followed, or if it's
+ * empty all lines are plotted with the given perfection threshold.
+ * returns the status of the last call to plot_spiral().
+ */
+static sxbp_status_t plot_scheduled(
+    const struct run_options_t* options, sxbp_spiral_t* spiral,
+    struct perfection_schedule_t* schedule, int perfection, uint32_t max_line,
+    void(* progress_callback)(
+        sxbp_spiral_t* spiral, uint32_t latest_line, uint32_t target_line,
+        void* progress_data
+    ),
+    void* progress_data, enum stop_request_t* stopped
+) {
+    *stopped = STOP_NONE;
+    if((options->target_time <= 0) && (schedule->count == 0)) {
+        return plot_spiral(
+            options, spiral, perfection, max_line, progress_callback,
+            progress_data, stopped
+        );
+    }
+    uint32_t last_line = (max_line < spiral->size) ? max_line : spiral->size;
+    if(options->target_time <= 0) {
+        // each step of the schedule is plotted in one go
+        while(spiral->solved_count < last_line) {
+            uint32_t solved_count = spiral->solved_count;
+            uint32_t end = next_schedule_line(schedule, solved_count);
+            sxbp_status_t result = plot_spiral(
+                options, spiral, scheduled_perfection(schedule, solved_count),
+                (end < last_line) ? end : last_line, progress_callback,
+                progress_data, stopped
+            );
+            if(
+                (result != SXBP_OPERATION_OK) || (*stopped != STOP_NONE) ||
+                (spiral->solved_count == solved_count)
+            ) {
+                return result;
+            }
+        }
+        return SXBP_OPERATION_OK;
+    }
+    // start at the slowest level no slower than the threshold given
+    size_t top_level = 0;
+    while(
+        (top_level + 1 < SCHEDULE_LEVEL_COUNT) &&
+        (
+            (perfection < 0) ||
+            (
+                (SCHEDULE_LEVELS[top_level + 1] > 0) &&
+                (SCHEDULE_LEVELS[top_level + 1] <= perfection)
+            )
+        )
+    ) {
+        top_level++;
+    }
+    size_t level = top_level;
+    uint32_t segment_size = (
+        (last_line > spiral->solved_count) ?
+        (last_line - spiral->solved_count - 1) / SCHEDULE_SEGMENTS + 1 : 1
+    );
+    double start_time = clock_seconds(CLOCK_MONOTONIC);
+    while(spiral->solved_count < last_line) {
+        uint32_t solved_count = spiral->solved_count;
+        uint32_t end = (
+            (last_line - solved_count > segment_size) ?
+            solved_count + segment_size : last_line
+        );
+        if(!add_schedule_step(schedule, solved_count, SCHEDULE_LEVELS[level])) {
+            return SXBP_MALLOC_REFUSED;
+        }
+        double segment_start = clock_seconds(CLOCK_MONOTONIC);
+        sxbp_status_t result = plot_spiral(
+            options, spiral, SCHEDULE_LEVELS[level], end, progress_callback,
+            progress_data, stopped
+        );
+        if(
+            (result != SXBP_OPERATION_OK) || (*stopped != STOP_NONE) ||
+            (spiral->solved_count == solved_count)
+        ) {
+            return result;
+        }
+        // estimate how long the rest will take at the rate this segment went
+        double now = clock_seconds(CLOCK_MONOTONIC);
+        double estimate = (
+            (now - segment_start) *
+            schedule_work(spiral->solved_count, last_line) /
+            schedule_work(solved_count, spiral->solved_count)
+        );
+        double time_left = options->target_time - (now - start_time);
+        if((estimate > time_left) && (level > 0)) {
+            level--;
+        } else if((estimate < time_left / 2) && (level < top_level)) {
+            level++;
+        }
+    }
+    return SXBP_OPERATION_OK;
+}
+
+/*
+ * private function, collects the paths of all of a run's outputs into the
+ * given array, which must have room for MAX_OUTPUTS of them, first the main
+ * one then any extra ones.
+ * returns how many there are.
+ */
+static size_t output_paths(
+    const struct run_options_t* options, const char** paths
+) {
+    paths[0] = options->output_file_path;
+    size_t count = 1;
+    for(
+        int i = 0; (i < options->extra_output_count) && (count < MAX_OUTPUTS);
+        i++
+    ) {
+        paths[count++] = options->extra_output_paths[i];
+    }
+    return count;
+}
+
+/*
+ * private function, returns the format to write the output at the given path
+ * in, when there's more than one: the one its extension names if sxbp knows
+ * it, otherwise the given default. sxp files are written in the given format.
+ */
+static enum spiral_render_mode_t render_mode_for_path(
+    const char* file_path, enum spiral_render_mode_t sxp_render_mode,
+    enum spiral_render_mode_t default_render_mode
+) {
+    const char* extension = strrchr(file_path, '.');
+    const char* file_name = strrchr(file_path, '/');
+    if(
+        (extension == NULL) ||
+        ((file_name != NULL) && (extension < file_name))
+    ) {
+        return default_render_mode;
+    } else if(strcmp(extension, ".sxp") == 0) {
+        return sxp_render_mode;
+    } else if(strcmp(extension, ".pbm") == 0) {
+        return RENDER_MODE_PBM;
+    } else if(strcmp(extension, ".png") == 0) {
+        return RENDER_MODE_PNG;
+    } else if(strcmp(extension, ".svg") == 0) {
+        return RENDER_MODE_SVG;
+    }
+    return default_render_mode;
+}
+
+/*
+ * private function, prepares or loads the spiral from the input buffer, then
+ * generates it and works out which format to write each of the run's outputs
+ * in (see output_paths()), as configured by the given options. if schedule
+ * isn't NULL, it's set to the perfection schedule the spiral was generated
+ * with as text allocated with malloc(), or NULL if it was generated with just
+ * one threshold. geometry is set to the geometry of the spiral, with the
+ * bounds known if they were loaded with it and it wasn't generated any further.
+ * the time each phase takes is recorded in stats, unless it is NULL.
+ * returns true on success, false on failure.
+ */
+static bool build_spiral(
+    const struct run_options_t* options, sxbp_buffer_t input_buffer,
+    sxbp_spiral_t* spiral, enum spiral_render_mode_t* render_modes,
+    char** schedule_text, struct spiral_geometry_t* geometry,
+    struct run_stats_t* stats
+) {
+    if(schedule_text != NULL) {
+        *schedule_text = NULL;
+    }
+    *geometry = (struct spiral_geometry_t){
+        .store = options->store_geometry, .known = false,
+        .bounds = {0, 0, 0, 0},
+    };
+    // resolve perfection threshold - set to -1 if disabled completely
+    int perfection = (
+        (options->perfect == false) ? -1 : options->perfect_threshold
+    );
+    // check error condition (where no actions were specified)
+    if((options->prepare || options->generate || options->render) == false) {
+        // none of the above. this is an error condition - nothing to be done
+        fprintf(stderr, "%s\n", "Nothing to be done!");
+        return false;
+    }
+    // a schedule is either followed or made to fit the time, not both
+    bool schedule_given = (
+        (options->schedule != NULL) && (strcmp(options->schedule, "") != 0)
+    );
+    if(schedule_given && (options->target_time > 0)) {
+        fprintf(
+            stderr, "%s\n",
+            "Can't follow a perfection schedule and a target time at once"
+        );
+        return false;
+    }
+    if(schedule_given) {
+        struct perfection_schedule_t schedule = {NULL, 0, 0, 0};
+        bool schedule_ok = parse_schedule(options->schedule, &schedule);
+        free(schedule.steps);
+        if(!schedule_ok) {
+            fprintf(
+                stderr, "Invalid perfection schedule: '%s'\n", options->schedule
+            );
+            return false;
+        }
+    }
+    // the schedule made depends on how fast the machine is, not just the input
+    if(
+        (options->target_time > 0) && (options->cache_dir != NULL) &&
+        (strcmp(options->cache_dir, "") != 0)
+    ) {
+        fprintf(stderr, "%s\n", "The cache can't be used with a target time");
+        return false;
+    }
+    // PBM format is default for rendering to image
+    enum spiral_render_mode_t default_render_mode = RENDER_MODE_PBM;
+    // override render image format if format option given
+    if(
+        (options->render == true) &&
+        (options->image_format != NULL) &&
+        (strcmp(options->image_format, "") != 0)
+    ) {
+        if(strcmp(options->image_format, "png") == 0) {
+            // check that PNG support is enabled in libsxbp
+            if(SXBP_PNG_SUPPORT == true) {
+                default_render_mode = RENDER_MODE_PNG;
+            } else {
+                // otheriwse, print an error message and return false
+                fprintf(
+                    stderr,
+                    "The loaded instance of libsxbp has not been "
+                    "compiled with PNG output support.\n"
+                );
+                return false;
+            }
+        } else if(strcmp(options->image_format, "pbm") == 0) {
+            // No-op as it's already set to PBM format
+            NULL;
+        } else if(strcmp(options->image_format, "svg") == 0) {
+            default_render_mode = RENDER_MODE_SVG;
+        } else {
+            // Error, unrecognised file format
+            fprintf(
+                stderr, "Unsupported image file format: '%s'\n",
+                options->image_format
+            );
+            return false;
+        }
+    }
+    // journals can only be found for spirals loaded from file
+    if(
+        options->resume &&
+        (
+            options->prepare ||
+            (strcmp(options->input_file_path, "") == 0) ||
+            (strcmp(options->input_file_path, "-") == 0)
+        )
+    ) {
+        fprintf(stderr, "%s\n", "Can only resume a spiral loaded from file");
+        return false;
+    }
+    // the cache is keyed by the input, which doesn't include the journal
+    if(
+        options->resume && (options->cache_dir != NULL) &&
+        (strcmp(options->cache_dir, "") != 0)
+    ) {
+        fprintf(stderr, "%s\n", "The cache can't be used when resuming");
+        return false;
+    }
+    // checkpoints can't be taken back once they've gone down a pipe
+    if(
+        ((options->save_every > 0) || options->journal || options->frames) &&
+        (strcmp(options->output_file_path, "-") == 0)
+    ) {
+        fprintf(
+            stderr, "%s\n", "Can't save checkpoints when writing to stdout"
+        );
+        return false;
+    }
+    // sxp files are written in the v1 format unless asked for another
+    enum spiral_render_mode_t sxp_render_mode = RENDER_MODE_SXP;
+    if(
+        (options->sxp_format != NULL) &&
+        (strcmp(options->sxp_format, "") != 0) &&
+        (strcmp(options->sxp_format, "v1") != 0)
+    ) {
+        if(strcmp(options->sxp_format, "v2") == 0) {
+            sxp_render_mode = RENDER_MODE_SXP_V2;
+        } else if(strcmp(options->sxp_format, "v2z") == 0) {
+            sxp_render_mode = RENDER_MODE_SXP_V2_COMPRESSED;
+        } else {
+            fprintf(
+                stderr, "Unsupported sxp file format: '%s'\n",
+                options->sxp_format
+            );
+            return false;
+        }
+    }
+    // use default image format if rendering to image, otherwise dump to sxp
+    enum spiral_render_mode_t fallback_render_mode = (
+        (options->render == false) ? sxp_render_mode : default_render_mode
+    );
+    /*
+     * with more than one output, each is written in the format its extension
+     * names, and the options only decide it for those with other extensions
+     */
+    const char* paths[MAX_OUTPUTS];
+    size_t output_count = output_paths(options, paths);
+    bool any_sxp = false;
+    bool any_image = false;
+    bool any_png = false;
+    bool any_svg = false;
+    size_t stdout_count = 0;
+    for(size_t i = 0; i < output_count; i++) {
+        render_modes[i] = (
+            (output_count == 1) ? fallback_render_mode :
+            render_mode_for_path(
+                paths[i], sxp_render_mode, fallback_render_mode
+            )
+        );
+        any_sxp = any_sxp || is_sxp_render_mode(render_modes[i]);
+        any_image = any_image || !is_sxp_render_mode(render_modes[i]);
+        any_png = any_png || (render_modes[i] == RENDER_MODE_PNG);
+        any_svg = any_svg || (render_modes[i] == RENDER_MODE_SVG);
+        stdout_count += (strcmp(paths[i], "-") == 0) ? 1 : 0;
+    }
+    // only the v2 format has room for geometry
+    if(
+        options->store_geometry && any_sxp &&
+        (sxp_render_mode == RENDER_MODE_SXP)
+    ) {
+        fprintf(stderr, "%s\n", "Geometry can only be stored in v2 sxp files");
+        return false;
+    }
+    // check that PNG support is enabled in libsxbp
+    if(any_png && (SXBP_PNG_SUPPORT == false)) {
+        fprintf(
+            stderr,
+            "The loaded instance of libsxbp has not been "
+            "compiled with PNG output support.\n"
+        );
+        return false;
+    }
+    // journals only record line changes, so only work with sxp output
+    if(options->journal && !is_sxp_render_mode(render_modes[0])) {
+        fprintf(stderr, "%s\n", "Journal mode can't be used when rendering");
+        return false;
+    }
+    // frames are for animating, a series of sxp files would be no use for that
+    if(options->frames && is_sxp_render_mode(render_modes[0])) {
+        fprintf(stderr, "%s\n", "Frames can only be written when rendering");
+        return false;
+    }
+    // tiles and scaling only make sense for images
+    if(
+        !any_image &&
+        ((options->view.tile_width > 0) || (options->view.scale > 1))
+    ) {
+        fprintf(
+            stderr, "%s\n", "Tiles and scaling can only be used when rendering"
+        );
+        return false;
+    }
+    // vector images can be scaled by whoever views them instead
+    if((options->view.tile_width > 0) && any_svg) {
+        fprintf(stderr, "%s\n", "SVG images can't be split into tiles");
+        return false;
+    }
+    // each tile is a file of its own
+    if((options->view.tile_width > 0) && (stdout_count > 0)) {
+        fprintf(stderr, "%s\n", "Can't write tiles to stdout");
+        return false;
+    }
+    // they'd all be mixed up together
+    if(stdout_count > 1) {
+        fprintf(stderr, "%s\n", "Only one output can be written to stdout");
+        return false;
+    }
+    // otherwise, good to go
+    // the perfection schedule recorded with a loaded spiral, if any
+    char* recorded_schedule = NULL;
+    begin_phase(stats);
+    if(options->prepare) {
+        // we must build spiral from raw file first
+        if(handle_error(sxbp_init_spiral(input_buffer, spiral))) {
+            // handle errors
+            return false;
+        }
+    } else {
+        // otherwise, we must load spiral from file
+        bool solved_only = (
+            any_image && !any_sxp && !options->generate && !options->resume
+        );
+        // a journal changes the lines, so stored geometry wouldn't match
+        sxbp_serialise_result_t result = load_spiral(
+            input_buffer, spiral, solved_only, &recorded_schedule,
+            options->resume ? NULL : geometry
+        );
+        // if we had problems, print to stderr and quit
+        if(result.status != SXBP_OPERATION_OK) {
+            fprintf(
+                stderr,
+                "Error Code:\t\t%s\nFile Error Code:\t%s\n",
+                error_code_string(result.status),
+                file_error_code_string(result.diagnostic)
+            );
+            return false;
+        }
+        // bring it up to date with the progress in its journal if asked to
+        if(options->resume) {
+            char* path = journal_path(options->input_file_path);
+            bool resume_ok = (
+                (path != NULL) && apply_journal(path, input_buffer, spiral)
+            );
+            free(path);
+            if(!resume_ok) {
+                free(recorded_schedule);
+                return false;
+            }
+        }
+    }
+    end_phase(stats, PHASE_INIT);
+    if(options->generate) {
+        /*
+         * generating may change any of the lines, so the bounds are worked out
+         * again. libsxbp keeps its co-ord cache in the spiral up to date
+         * itself, so one loaded with the spiral spares it rebuilding it.
+         */
+        geometry->known = false;
+        /*
+         * find out how many lines we are to plot
+         * this is based on two options: the line_limit and the total_lines
+         * arguments.
+         */
+        // first, check the line_limit argument
+        uint32_t lines_to_plot;
+        // set to solved count + line limit if set, else spiral size
+        lines_to_plot = (
+            (options->line_limit != -1) ?
+            (spiral->solved_count + (uint32_t)options->line_limit) :
+            spiral->size
+        );
+        // set to total_lines if set and less than current amount
+        lines_to_plot = (
+            (
+                options->total_lines != -1 &&
+                (uint32_t)options->total_lines < lines_to_plot
+            ) ?
+            (uint32_t)options->total_lines : lines_to_plot
+        );
+        /*
+         * we must plot the unsolved lines from spiral file
+         * NOTE: this is single-threaded, the solver lives entirely inside
+         * libsxbp and each line depends on the final state of all the lines
+         * before it, so we have no way to split one solve across threads that
+         * still gives the same result. Parallelism is across spirals instead,
+         * see run_batch().
+         * the same goes for how collisions are found: libsxbp checks each
+         * candidate line against the co-ordinates it caches in the spiral, and
+         * we have no way to give it an index of our own to use instead.
+         */
+        /*
+         * the lines are solved following the schedule given, or else the one
+         * the spiral was solved with so far. with a target time, the schedule
+         * so far is kept and the rest of it made up as we go.
+         */
+        struct perfection_schedule_t schedule = {NULL, 0, 0, 0};
+        const char* schedule_source = (
+            schedule_given ? options->schedule : recorded_schedule
+        );
+        if(
+            (schedule_source != NULL) &&
+            !parse_schedule(schedule_source, &schedule)
+        ) {
+            fprintf(
+                stderr, "Invalid perfection schedule: '%s'\n", schedule_source
+            );
+            free(schedule.steps);
+            free(recorded_schedule);
+            return false;
+        }
+        while(
+            (options->target_time > 0) && (schedule.count > 0) &&
+            (schedule.steps[schedule.count - 1].line >= spiral->solved_count)
+        ) {
+            schedule.count--;
+            schedule.changes++;
+        }
+        // look for this spiral already solved in the cache, if there is one
+        char cache_key[CACHE_KEY_SIZE];
+        // there's no more to plot than the whole spiral
+        uint32_t cache_line = (
+            (lines_to_plot < spiral->size) ? lines_to_plot : spiral->size
+        );
+        bool use_cache = (
+            (options->cache_dir != NULL) &&
+            (strcmp(options->cache_dir, "") != 0) &&
+            (spiral->solved_count < cache_line)
+        );
+        enum cache_result_t cache_result = CACHE_MISS;
+        if(use_cache) {
+            begin_phase(stats);
+            make_cache_key(
+                input_buffer, options->prepare, perfection, schedule_source,
+                cache_key
+            );
+            cache_result = fetch_cached_spiral(
+                options->cache_dir, cache_key, cache_line, spiral
+            );
+            end_phase(stats, PHASE_INIT);
+            if(stats != NULL) {
+                stats->cache_result = CACHE_RESULT_NAMES[cache_result];
+            }
+        }
+        sxbp_status_t errors = SXBP_OPERATION_OK;
+        enum stop_request_t stopped = STOP_NONE;
+        // a signal can ask for a checkpoint of any run that has a file to save
+        bool checkpoint_on_signal = (
+            signals_handled && (strcmp(options->output_file_path, "-") != 0)
+        );
+        begin_phase(stats);
+        begin_solve(stats, spiral, lines_to_plot);
+        if(cache_result == CACHE_HIT) {
+            // no-op, it's already solved
+            NULL;
+        } else if(
+            (options->save_every > 0) || (stats != NULL) || checkpoint_on_signal
+        ) {
+            /*
+             * if we've been asked to save every x lines or collect stats, we
+             * need to use callback
+             */
+            // checkpoints are written in the background by a writer thread
+            struct checkpoint_writer_t writer;
+            bool checkpoints = (
+                (options->save_every > 0) || checkpoint_on_signal
+            );
+            if(checkpoints) {
+                start_checkpoint_writer(
+                    &writer, render_modes[0], &options->view,
+                    options->output_file_path, options->journal,
+                    options->store_geometry, options->frames
+                );
+            }
+            // build user data for callback
+            struct user_data_t user_data = {
+                .save_line_interval = (
+                    (options->save_every > 0) ?
+                    (uint32_t)options->save_every : 0
+                ),
+                .writer = checkpoints ? &writer : NULL,
+                .stats = stats,
+                .checkpoint_signals = 0,
+                .schedule = &schedule,
+            };
+            // only signals caught from now on ask for a checkpoint of this run
+            checkpoint_signalled(&user_data.checkpoint_signals);
+            errors = plot_scheduled(
+                options, spiral, &schedule, perfection, lines_to_plot,
+                plot_spiral_callback, (void*)&user_data, &stopped
+            );
+            // wait for the last checkpoint, so it can't replace our output
+            if(checkpoints) {
+                stop_checkpoint_writer(&writer);
+            }
+        } else {
+            // otherwise, no need to use callback
+            errors = plot_scheduled(
+                options, spiral, &schedule, perfection, lines_to_plot, NULL,
+                NULL, &stopped
+            );
+        }
+        end_phase(stats, PHASE_GENERATE);
+        // the schedule goes out with the spiral, in place of the one read in
+        bool schedule_ok = true;
+        if(schedule.count > 0) {
+            free(recorded_schedule);
+            recorded_schedule = format_schedule(&schedule);
+            schedule_ok = (recorded_schedule != NULL);
+        }
+        free(schedule.steps);
+        // handle errors
+        if(handle_error(errors)) {
+            // handle errors
+            free(recorded_schedule);
+            return false;
+        } else if(!schedule_ok) {
+            handle_error(SXBP_MALLOC_REFUSED);
+            return false;
+        } else if(stopped == STOP_CANCEL) {
+            fprintf(stderr, "%s\n", "Stopped before the spiral was solved");
+            free(recorded_schedule);
+            return false;
+        } else if(stopped == STOP_SAVE) {
+            // a partial solution isn't what the cache was asked for
+            fprintf(
+                stderr, "Stopped after solving %" PRIu32 " of %" PRIu32
+                " lines, saving the progress so far\n",
+                spiral->solved_count, cache_line
+            );
+        } else if(use_cache && (cache_result != CACHE_HIT)) {
+            // save the solution for next time
+            store_cached_spiral(
+                options->cache_dir, cache_key, cache_line, spiral,
+                (uint64_t)options->cache_size * 1024 * 1024
+            );
+        }
+        // say what was chosen, so it can be given to --schedule to do again
+        if((options->target_time > 0) && (recorded_schedule != NULL)) {
+            fprintf(stderr, "Perfection schedule: %s\n", recorded_schedule);
+        }
+    }
+    if(schedule_text != NULL) {
+        *schedule_text = recorded_schedule;
+    } else {
+        free(recorded_schedule);
+    }
+    return true;
+}
+
+// name of the manifest file in a shard container
+#define SHARD_MANIFEST_NAME "manifest"
+
+/*
+ * private structure, one shard of a sharded run: a chunk of the input which is
+ * turned into a spiral of its own
+ */
+struct shard_t {
+    uint64_t offset; // where the shard's chunk starts in the whole input
+    uint64_t size; // size of the shard's chunk in bytes
+    char* input_path; // path of the shard's sxp file, if read from a container
+    char* output_path; // path to write the shard's sxp file to, if any
+    enum spiral_render_mode_t render_mode; // format the shard was made for
+    struct raster_outline_t outline; // the shard's pixels, if making a mosaic
+    bool ok; // whether the shard was made successfully
+};
+
+/*
+ * private structure, holds the shards of a sharded run and the state shared
+ * between the worker threads which are processing them
+ */
+struct shard_set_t {
+    struct shard_t* shards; // array of shards
+    size_t count; // number of shards in the array
+    size_t next; // index of the next shard no worker has taken yet
+    pthread_mutex_t lock; // guards next
+    const struct run_options_t* options; // options shared by all shards
+    sxbp_buffer_t input; // whole input the shards are cut from, if not read
+    bool mosaic; // whether the shards are to be rendered as one image
+};
+
+/*
+ * private function, returns a newly allocated path of the file with the given
+ * name in the given directory, or NULL if memory couldn't be allocated
+ */
+static char* join_path(const char* directory, const char* name) {
+    size_t size = strlen(directory) + strlen(name) + 2;
+    char* path = malloc(size);
+    if(path != NULL) {
+        snprintf(path, size, "%s/%s", directory, name);
+    }
+    return path;
+}
+
+/*
+ * private function, reads the manifest of a shard container, filling in the
+ * offset, size and input path of each shard listed.
+ * each line of the manifest holds the name of a shard's sxp file in the
+ * container, then the offset and size of its chunk of the original input.
+ * blank lines and lines starting with '#' are ignored.
+ * returns true on success, false on failure.
+ */
+static bool read_shard_manifest(
+    const char* container, struct shard_t** shards, size_t* count
+) {
+    char* manifest_path = join_path(container, SHARD_MANIFEST_NAME);
+    FILE* manifest_file = (
+        (manifest_path == NULL) ? NULL : fopen(manifest_path, "r")
+    );
+    if(manifest_file == NULL) {
+        fprintf(stderr, "Couldn't open shard manifest in: %s\n", container);
+        free(manifest_path);
+        return false;
+    }
+    bool ok = true;
+    size_t capacity = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    size_t line_number = 0;
+    while(ok && (getline(&line, &line_size, manifest_file) != -1)) {
+        line_number++;
+        char name[256];
+        uint64_t offset, size;
+        char extra;
+        size_t skipped = strspn(line, " \t\r\n");
+        if((line[skipped] == '\0') || (line[skipped] == '#')) {
+            // blank line or comment, skip it
+            continue;
+        } else if(
+            (
+                sscanf(
+                    line, "%255s %" SCNu64 " %" SCNu64 " %c",
+                    name, &offset, &size, &extra
+                ) != 3
+            ) || (strchr(name, '/') != NULL)
+        ) {
+            fprintf(
+                stderr, "%s:%zu: expected a shard file, offset and size\n",
+                manifest_path, line_number
+            );
+            ok = false;
+            continue;
+        }
+        if(*count == capacity) {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            struct shard_t* grown = realloc(
+                *shards, capacity * sizeof(struct shard_t)
+            );
+            if(grown == NULL) {
+                fprintf(stderr, "%s\n", "Couldn't allocate memory for shards");
+                ok = false;
+                continue;
+            }
+            *shards = grown;
+        }
+        struct shard_t* shard = &(*shards)[*count];
+        memset(shard, 0, sizeof(struct shard_t));
+        shard->offset = offset;
+        shard->size = size;
+        shard->input_path = join_path(container, name);
+        (*count)++;
+        if(shard->input_path == NULL) {
+            fprintf(stderr, "%s\n", "Couldn't allocate memory for shards");
+            ok = false;
+        }
+    }
+    free(line);
+    fclose(manifest_file);
+    free(manifest_path);
+    return ok;
+}
+
+/*
+ * private function, writes the manifest of a shard container listing the given
+ * shards, which must have been written to files in it.
+ * returns true on success, false on failure.
+ */
+static bool write_shard_manifest(
+    const char* container, const struct shard_t* shards, size_t count
+) {
+    char* manifest_bytes = NULL;
+    size_t manifest_size = 0;
+    char* manifest_path = join_path(container, SHARD_MANIFEST_NAME);
+    FILE* manifest_file = (
+        (manifest_path == NULL) ? NULL :
+        open_memstream(&manifest_bytes, &manifest_size)
+    );
+    if(manifest_file == NULL) {
+        free(manifest_path);
+        return false;
+    }
+    fprintf(manifest_file, "%s\n", "# shard file, input offset, input size");
+    for(size_t i = 0; i < count; i++) {
+        // the files are named relative to the container
+        const char* name = strrchr(shards[i].output_path, '/') + 1;
+        fprintf(
+            manifest_file, "%s %" PRIu64 " %" PRIu64 "\n",
+            name, shards[i].offset, shards[i].size
+        );
+    }
+    bool ok = (fclose(manifest_file) == 0);
+    // written whole and renamed into place, like any other output
+    sxbp_buffer_t manifest = {(uint8_t*)manifest_bytes, manifest_size};
+    ok = ok && buffer_to_path(&manifest, manifest_path, false);
+    free(manifest_bytes);
+    free(manifest_path);
+    return ok;
+}
+
+/*
+ * private function, worker thread entry point for sharded runs.
+ * takes shards from the set one at a time and makes a spiral of each, which is
+ * either written to its own sxp file or traced ready for the mosaic, until
+ * there are none left.
+ */
+static void* shard_worker(void* set_void_pointer) {
+    struct shard_set_t* set = (struct shard_set_t*)set_void_pointer;
+    while(true) {
+        // claim the next shard, if any are left
+        pthread_mutex_lock(&set->lock);
+        size_t index = set->next;
+        if(index < set->count) {
+            set->next++;
+        }
+        pthread_mutex_unlock(&set->lock);
+        if(index >= set->count) {
+            return NULL;
+        }
+        struct shard_t* shard = &set->shards[index];
+        /*
+         * each shard is processed as if it were the whole input, loaded from
+         * and saved to its own file in the container
+         */
+        struct run_options_t options = *set->options;
+        options.shard_size = 0;
+        options.input_string = "";
+        options.input_file_path = (
+            (shard->input_path != NULL) ? shard->input_path : ""
+        );
+        if(shard->output_path != NULL) {
+            options.output_file_path = shard->output_path;
+        }
+        struct input_buffer_t input = {{0, 0}, INPUT_STORAGE_BORROWED};
+        if(shard->input_path != NULL) {
+            shard->ok = path_to_input(shard->input_path, &input);
+        } else {
+            // a chunk of the whole input, which outlives the workers
+            input.buffer.bytes = set->input.bytes + shard->offset;
+            input.buffer.size = (size_t)shard->size;
+            shard->ok = true;
+        }
+        sxbp_spiral_t spiral = sxbp_blank_spiral();
+        char* schedule = NULL;
+        struct spiral_geometry_t geometry;
+        shard->ok = shard->ok && build_spiral(
+            &options, input.buffer, &spiral, &shard->render_mode, &schedule,
+            &geometry, NULL
+        );
+        if(shard->ok && set->mosaic) {
+            struct spiral_bounds_t bounds = spiral_bounds(&spiral, &geometry);
+            shard->ok = trace_raster_outline(
+                &spiral, &bounds, 1, &shard->outline
+            );
+        } else if(shard->ok) {
+            shard->ok = spiral_to_path(
+                &spiral, schedule, &geometry, shard->render_mode, &options.view,
+                shard->output_path, options.direct_io, NULL
+            );
+            // the shard's file holds all its progress now
+            char* path = (
+                (shard->ok && options.journal) ?
+                journal_path(shard->output_path) : NULL
+            );
+            if(path != NULL) {
+                remove(path);
+            }
+            free(path);
+        }
+        free(schedule);
+        free_spiral(&spiral);
+        free_input(&input);
+        if(!shard->ok) {
+            fprintf(stderr, "Shard %zu failed\n", index);
+        }
+    }
+}
+
+/*
+ * private function, lays the outlines of the given shards out in a grid, in
+ * order from left to right then top to bottom, as the outline of one image.
+ * if scale is more than 1, the image is shrunk by that much.
+ * returns true on success and false on failure.
+ */
+static bool compose_mosaic(
+    const struct shard_t* shards, size_t count, uint32_t scale,
+    struct raster_outline_t* mosaic
+) {
+    // as near to square as the number of shards allows
+    size_t columns = 1;
+    while(columns * columns < count) {
+        columns++;
+    }
+    size_t rows = (count + columns - 1) / columns;
+    // each column is as wide as its widest shard, each row as its tallest
+    uint64_t* column_left = calloc(columns + 1, sizeof(uint64_t));
+    uint64_t* row_top = calloc(rows + 1, sizeof(uint64_t));
+    bool ok = (column_left != NULL) && (row_top != NULL);
+    size_t segment_count = 0;
+    for(size_t i = 0; ok && (i < count); i++) {
+        uint64_t* width = &column_left[i % columns + 1];
+        uint64_t* height = &row_top[i / columns + 1];
+        *width = (shards[i].outline.width > *width) ?
+            shards[i].outline.width : *width;
+        *height = (shards[i].outline.height > *height) ?
+            shards[i].outline.height : *height;
+        segment_count += shards[i].outline.segment_count;
+    }
+    for(size_t i = 0; ok && (i < columns); i++) {
+        column_left[i + 1] += column_left[i];
+    }
+    for(size_t i = 0; ok && (i < rows); i++) {
+        row_top[i + 1] += row_top[i];
+    }
+    if(
+        ok &&
+        ((column_left[columns] > UINT32_MAX) || (row_top[rows] > UINT32_MAX))
+    ) {
+        fprintf(stderr, "%s\n", "Mosaic is too big to render");
+        ok = false;
+    }
+    mosaic->segments = ok ? calloc(
+        (segment_count > 0) ? segment_count : 1,
+        sizeof(struct raster_segment_t)
+    ) : NULL;
+    ok = ok && (mosaic->segments != NULL);
+    if(ok) {
+        // move each shard's segments to its place in the grid
+        struct raster_segment_t* segment = mosaic->segments;
+        for(size_t i = 0; i < count; i++) {
+            uint32_t left = (uint32_t)column_left[i % columns];
+            uint32_t top = (uint32_t)row_top[i / columns];
+            for(size_t j = 0; j < shards[i].outline.segment_count; j++) {
+                *segment = shards[i].outline.segments[j];
+                segment->first_row = (segment->first_row + top) / scale;
+                segment->last_row = (segment->last_row + top) / scale;
+                segment->first_column = (segment->first_column + left) / scale;
+                segment->last_column = (segment->last_column + left) / scale;
+                // when scaled down, the gaps in the first line are filled in
+                segment->step = (scale == 1) ? segment->step : 1;
+                segment++;
+            }
+        }
+        mosaic->segment_count = segment_count;
+        // round up, so that the last pixels still have somewhere to go
+        mosaic->width = (uint32_t)((column_left[columns] + scale - 1) / scale);
+        mosaic->height = (uint32_t)((row_top[rows] + scale - 1) / scale);
+        qsort(
+            mosaic->segments, mosaic->segment_count,
+            sizeof(struct raster_segment_t), compare_raster_segments
+        );
+    }
+    free(column_left);
+    free(row_top);
+    return ok;
+}
+
+/*
+ * private function, processes an input as many spirals, one for each chunk of
+ * it the shard size long, made in parallel. if preparing, the chunks are cut
+ * from the input, otherwise the input is a container of shards written by an
+ * earlier sharded run, which needs no shard size. the shards are either
+ * written to a container of their own, or rendered together as one mosaic
+ * image.
+ * returns true on success, false on failure.
+ */
+static bool run_sharded(
+    const struct run_options_t* options, struct run_stats_t* stats
+) {
+    struct stat input_stat;
+    bool from_container = (
+        (strcmp(options->input_file_path, "") != 0) &&
+        (stat(options->input_file_path, &input_stat) == 0) &&
+        S_ISDIR(input_stat.st_mode)
+    );
+    if(options->prepare == from_container) {
+        fprintf(
+            stderr, "%s\n",
+            "Sharding needs either raw input to prepare or a shard container"
+        );
+        return false;
+    } else if(
+        options->render &&
+        ((options->save_every > 0) || options->journal || options->frames)
+    ) {
+        // there's no file of its own for each shard to save checkpoints to
+        fprintf(stderr, "%s\n", "Can't save checkpoints of a mosaic");
+        return false;
+    } else if(options->extra_output_count > 0) {
+        fprintf(stderr, "%s\n", "Only one output can be given when sharding");
+        return false;
+    } else if(options->target_time > 0) {
+        // the shards are solved side by side, they can't share out the time
+        fprintf(stderr, "%s\n", "A target time can't be used when sharding");
+        return false;
+    } else if(
+        options->render && (options->image_format != NULL) &&
+        (strcmp(options->image_format, "svg") == 0)
+    ) {
+        // shards are put together as pixels, there are no lines left by then
+        fprintf(stderr, "%s\n", "Mosaics can only be rendered to pbm or png");
+        return false;
+    } else if(
+        !options->render &&
+        (
+            (strcmp(options->output_file_path, "") == 0) ||
+            (strcmp(options->output_file_path, "-") == 0)
+        )
+    ) {
+        fprintf(stderr, "%s\n", "A shard container must be written to a path");
+        return false;
+    } else if(
+        !options->render &&
+        (mkdir(options->output_file_path, 0777) != 0) && (errno != EEXIST)
+    ) {
+        fprintf(
+            stderr, "Couldn't create shard container: %s\n",
+            options->output_file_path
+        );
+        return false;
+    }
+    struct shard_set_t set = {
+        .shards = NULL, .count = 0, .next = 0, .options = options,
+        .input = {0, 0}, .mosaic = options->render,
+    };
+    struct input_buffer_t input = {{0, 0}, INPUT_STORAGE_BORROWED};
+    bool ok = true;
+    begin_phase(stats);
+    if(from_container) {
+        ok = read_shard_manifest(
+            options->input_file_path, &set.shards, &set.count
+        );
+    } else {
+        if(strcmp(options->input_file_path, "") == 0) {
+            string_to_input(options->input_string, &input);
+        } else {
+            ok = path_to_input(options->input_file_path, &input);
+        }
+        set.input = input.buffer;
+        size_t shard_size = (size_t)options->shard_size;
+        set.count = ok ? (input.buffer.size + shard_size - 1) / shard_size : 0;
+        set.shards = ok ? calloc(set.count, sizeof(struct shard_t)) : NULL;
+        ok = ok && (set.shards != NULL);
+        for(size_t i = 0; ok && (i < set.count); i++) {
+            set.shards[i].offset = (uint64_t)i * shard_size;
+            set.shards[i].size = (
+                (input.buffer.size - i * shard_size < shard_size) ?
+                input.buffer.size - i * shard_size : shard_size
+            );
+        }
+    }
+    end_phase(stats, PHASE_READ);
+    if(ok && (set.count == 0)) {
+        fprintf(stderr, "%s\n", "There's nothing to shard");
+        ok = false;
+    }
+    // without a mosaic, each shard is written to a file in the container
+    for(size_t i = 0; ok && !set.mosaic && (i < set.count); i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "%zu.sxp", i);
+        set.shards[i].output_path = join_path(options->output_file_path, name);
+        ok = (set.shards[i].output_path != NULL);
+    }
+    if(ok) {
+        // no more workers than there are shards, the calling thread is one
+        size_t worker_count = (
+            (options->view.jobs < 1) ? 1 : (size_t)options->view.jobs
+        );
+        worker_count = (worker_count > set.count) ? set.count : worker_count;
+        pthread_mutex_init(&set.lock, NULL);
+        pthread_t* workers = calloc(worker_count, sizeof(pthread_t));
+        size_t started = 0;
+        if(workers != NULL) {
+            while(
+                (started < worker_count - 1) &&
+                (pthread_create(
+                    &workers[started], NULL, shard_worker, &set
+                ) == 0)
+            ) {
+                started++;
+            }
+        }
+        begin_phase(stats);
+        shard_worker(&set);
+        for(size_t i = 0; i < started; i++) {
+            pthread_join(workers[i], NULL);
+        }
+        end_phase(stats, PHASE_GENERATE);
+        free(workers);
+        pthread_mutex_destroy(&set.lock);
+        for(size_t i = 0; i < set.count; i++) {
+            ok = ok && set.shards[i].ok;
+        }
+    }
+    if(ok) {
+        begin_phase(stats);
+        if(set.mosaic) {
+            struct raster_outline_t mosaic = {0, 0, NULL, 0};
+            ok = compose_mosaic(
+                set.shards, set.count, options->view.scale, &mosaic
+            );
+            if(ok && (options->view.tile_width > 0)) {
+                ok = render_tiles(
+                    &mosaic, NULL, set.shards[0].render_mode, &options->view,
+                    options->output_file_path, options->direct_io
+                );
+            } else if(ok) {
+                ok = outline_to_path(
+                    &mosaic, set.shards[0].render_mode,
+                    options->view.png_level, options->view.jobs,
+                    options->output_file_path, options->direct_io
+                );
+            }
+            free(mosaic.segments);
+        } else {
+            ok = write_shard_manifest(
+                options->output_file_path, set.shards, set.count
+            );
+        }
+        end_phase(stats, PHASE_WRITE);
+        if(!ok) {
+            fprintf(stderr, "%s\n", "Couldn't write output file");
+        }
+    }
+    for(size_t i = 0; i < set.count; i++) {
+        free(set.shards[i].input_path);
+        free(set.shards[i].output_path);
+        free(set.shards[i].outline.segments);
+    }
+    free(set.shards);
+    free_input(&input);
+    return ok;
+}
+
+/*
+ * private function, processes one input into its outputs as configured by the
+ * given options, recording the time each phase takes in stats unless it is
+ * NULL.
+ * returns true on success, false on failure.
+ */
+static bool run_timed(
+    const struct run_options_t* options, struct run_stats_t* stats
+) {
+    // make input buffer
+    struct input_buffer_t input = {{0, 0}, INPUT_STORAGE_BORROWED};
+    // format to write each output in
+    enum spiral_render_mode_t render_modes[MAX_OUTPUTS];
+    // used later for telling if read from input file or string was success
+    bool read_ok = false;
+    // used later for telling if write of output file was success
+    bool write_ok = false;
+    // work out whether we're reading from string or file or if neither were given
+    if(
+        (strcmp(options->input_file_path, "") == 0) &&
+        (strcmp(options->input_string, "") == 0)
+    ) {
+        fprintf(stderr, "Neither an input file or an input string were given\n");
+        return false;
+    }
+    // sharded inputs, and containers of shards, are processed as many spirals
+    struct stat input_stat;
+    if(
+        (options->shard_size > 0) ||
+        (
+            (stat(options->input_file_path, &input_stat) == 0) &&
+            S_ISDIR(input_stat.st_mode)
+        )
+    ) {
+        return run_sharded(options, stats);
+    }
+    begin_phase(stats);
+    if(strcmp(options->input_file_path, "") == 0) {
+        // the filepath wasn't given so read from string
+        string_to_input(options->input_string, &input);
+        read_ok = true;
+    } else {
+        // the string wasn't given so map or read the file (or stdin)
+        read_ok = path_to_input(options->input_file_path, &input);
+    }
+    end_phase(stats, PHASE_READ);
+    if(read_ok == false) {
+        fprintf(stderr, "%s\n", "Couldn't read input file/data");
+        return false;
+    }
+    // create initial blank spiral struct
+    sxbp_spiral_t spiral = sxbp_blank_spiral();
+    // the perfection schedule it was generated with, if there was one
+    char* schedule = NULL;
+    // what's been worked out from its lines, if it was loaded with any
+    struct spiral_geometry_t geometry;
+    // do all the work on the spiral, then write it out if that went well
+    if(
+        build_spiral(
+            options, input.buffer, &spiral, render_modes, &schedule, &geometry,
+            stats
+        )
+    ) {
+        // write the output files, replacing any checkpoint atomically
+        const char* paths[MAX_OUTPUTS];
+        size_t output_count = output_paths(options, paths);
+        if(output_count == 1) {
+            write_ok = spiral_to_path(
+                &spiral, schedule, &geometry, render_modes[0], &options->view,
+                paths[0], options->direct_io, stats
+            );
+        } else {
+            write_ok = spiral_to_paths(
+                &spiral, schedule, &geometry, render_modes, &options->view,
+                paths, output_count, options->direct_io, stats
+            );
+        }
+        if(!write_ok) {
+            fprintf(stderr, "%s\n", "Couldn't write output file");
+        } else if(options->journal) {
+            // the output holds all progress now, so its journal is spent
+            char* path = journal_path(options->output_file_path);
+            if(path != NULL) {
+                remove(path);
+            }
+            free(path);
+        }
+    }
+    // free buffers and spiral, even on failure as we may be run many times
+    free(schedule);
+    free_spiral(&spiral);
+    free_input(&input);
+    // return success depends on last write
+    return write_ok;
+}
+
+/*
+ * function responsible for actually doing the main work, called by main with
+ * options configured via command-line. stopped is set to whether the run was
+ * stopped early by its limits or a signal, in which case its output holds the
+ * progress made before then.
+ * returns true on success, false on failure.
+ */
+static bool run(const struct run_options_t* options, bool* stopped) {
+    // check the run's limits, and for signals, before plotting each line
+    struct run_limits_t limits;
+    start_run_limits(
+        &limits, options->deadline, options->max_rss,
+        options->should_stop, options->stop_context
+    );
+    struct run_options_t limited_options = *options;
+    limited_options.should_stop = check_run_limits;
+    limited_options.stop_context = &limits;
+    bool run_ok = false;
+    // only pay for collecting statistics if someone is going to see them
+    if(
+        ((options->stats_file_path == NULL) ||
+        (strcmp(options->stats_file_path, "") == 0)) &&
+        (options->progress_interval <= 0)
+    ) {
+        run_ok = run_timed(&limited_options, NULL);
+    } else {
+        // this is too big to comfortably live on the stack
+        struct run_stats_t* stats = malloc(sizeof(struct run_stats_t));
+        if(stats == NULL) {
+            fprintf(stderr, "%s\n", "Couldn't allocate memory for statistics");
+        } else {
+            init_run_stats(stats, (double)options->progress_interval);
+            run_ok = run_timed(&limited_options, stats);
+            // write statistics even if the run failed, they may show us why
+            if(
+                (options->stats_file_path != NULL) &&
+                (strcmp(options->stats_file_path, "") != 0) &&
+                !write_run_stats(stats, run_ok, options->stats_file_path)
+            ) {
+                fprintf(stderr, "%s\n", "Couldn't write statistics file");
+                run_ok = false;
+            }
+            free(stats->lengths);
+            free(stats);
+        }
+    }
+    *stopped = limits.stopped;
+    pthread_mutex_destroy(&limits.lock);
+    return run_ok;
+}
+
+/*
+ * private structure, represents one job of a batch run: one input file to be
+ * turned into one output file
+ */
+struct batch_item_t {
+    char* input_file_path; // path of file to read input from
+    char* output_file_path; // path of file to write output to
+    bool ok; // whether the job completed successfully
+    bool stopped; // whether the job was stopped before it finished
+};
+
+/*
+ * private structure, holds the list of jobs of a batch run and the state shared
+ * between the worker threads which are processing them
+ */
+struct batch_t {
+    struct batch_item_t* items; // dynamic array of jobs
+    size_t count; // number of jobs in the array
+    size_t capacity; // number of jobs the array has room for
+    size_t next; // index of the next job no worker has taken yet
+    pthread_mutex_t lock; // guards next
+    const struct run_options_t* options; // options shared by all jobs
+};
+
+/*
+ * private function, adds a job with copies of the given paths to a batch.
+ * returns true on success, false on failure.
+ */
+static bool add_batch_item(
+    struct batch_t* batch, const char* input_path, const char* output_path
+) {
+    // grow the array if it's full
+    if(batch->count == batch->capacity) {
+        size_t capacity = (batch->capacity == 0) ? 64 : batch->capacity * 2;
+        struct batch_item_t* items = realloc(
+            batch->items, capacity * sizeof(struct batch_item_t)
+        );
+        if(items == NULL) {
+            return false;
+        }
+        batch->items = items;
+        batch->capacity = capacity;
+    }
+    struct batch_item_t item = {
+        .input_file_path = strdup(input_path),
+        .output_file_path = strdup(output_path),
+        .ok = false,
+        .stopped = false,
+    };
+    if((item.input_file_path == NULL) || (item.output_file_path == NULL)) {
+        free(item.input_file_path);
+        free(item.output_file_path);
+        return false;
+    }
+    batch->items[batch->count++] = item;
+    return true;
+}
+
+/*
+ * private function, reads a batch manifest file into a batch.
+ * each line of the manifest holds an input path and an output path separated
+ * by whitespace, blank lines and lines starting with '#' are ignored.
+ * returns true on success, false on failure.
+ */
+static bool read_batch_manifest(
+    const char* manifest_path, struct batch_t* batch
+) {
+    FILE* manifest_file = fopen(manifest_path, "r");
+    if(manifest_file == NULL) {
+        fprintf(stderr, "Couldn't open batch manifest: %s\n", manifest_path);
+        return false;
+    }
+    bool ok = true;
+    char* line = NULL;
+    size_t line_size = 0;
+    size_t line_number = 0;
+    while(ok && (getline(&line, &line_size, manifest_file) != -1)) {
+        line_number++;
+        // split line into whitespace-separated fields in-place
+        char* fields[3] = {NULL, NULL, NULL};
+        size_t field_count = 0;
+        char* cursor = line;
+        while((*cursor != '\0') && (field_count < 3)) {
+            // skip leading whitespace
+            cursor += strspn(cursor, " \t\r\n");
+            if((*cursor == '\0') || (*cursor == '#' && field_count == 0)) {
+                break;
+            }
+            fields[field_count++] = cursor;
+            cursor += strcspn(cursor, " \t\r\n");
+            if(*cursor != '\0') {
+                *cursor++ = '\0';
+            }
+        }
+        if(field_count == 0) {
+            // blank line or comment, skip it
+            continue;
+        } else if(field_count != 2) {
+            fprintf(
+                stderr, "%s:%zu: expected an input path and an output path\n",
+                manifest_path, line_number
+            );
+            ok = false;
+        } else if(!add_batch_item(batch, fields[0], fields[1])) {
+            fprintf(stderr, "%s\n", "Couldn't allocate memory for batch");
+            ok = false;
+        }
+    }
+    free(line);
+    fclose(manifest_file);
+    return ok;
+}
+
+// private function, compares two batch items by input path, for use by qsort()
+static int compare_batch_items(const void* a, const void* b) {
+    return strcmp(
+        ((const struct batch_item_t*)a)->input_file_path,
+        ((const struct batch_item_t*)b)->input_file_path
+    );
+}
+
+/*
+ * private function, fills a batch with a job for every regular file in the
+ * given input directory. outputs are written to the given output directory,
+ * named after the input file with the extension of the output format appended.
+ * returns true on success, false on failure.
+ */
+static bool read_batch_directory(
+    const char* input_directory, const char* output_directory,
+    const char* extension, struct batch_t* batch
+) {
+    DIR* directory = opendir(input_directory);
+    if(directory == NULL) {
+        fprintf(stderr, "Couldn't open batch directory: %s\n", input_directory);
+        return false;
+    }
+    bool ok = true;
+    struct dirent* entry = NULL;
+    while(ok && ((entry = readdir(directory)) != NULL)) {
+        // skip hidden files, which also skips '.' and '..'
+        if(entry->d_name[0] == '.') {
+            continue;
+        }
+        // build the paths of the input and output files
+        size_t input_size = (
+            strlen(input_directory) + strlen(entry->d_name) + 2
+        );
+        size_t output_size = (
+            strlen(output_directory) + strlen(entry->d_name) +
+            strlen(extension) + 2
+        );
+        char* input_path = malloc(input_size);
+        char* output_path = malloc(output_size);
+        if((input_path == NULL) || (output_path == NULL)) {
+            fprintf(stderr, "%s\n", "Couldn't allocate memory for batch");
+            ok = false;
+        } else {
+            snprintf(
+                input_path, input_size, "%s/%s", input_directory, entry->d_name
+            );
+            snprintf(
+                output_path, output_size, "%s/%s%s",
+                output_directory, entry->d_name, extension
+            );
+            // only regular files are inputs
+            struct stat input_stat;
+            if(
+                (stat(input_path, &input_stat) == 0) &&
+                S_ISREG(input_stat.st_mode) &&
+                !add_batch_item(batch, input_path, output_path)
+            ) {
+                fprintf(stderr, "%s\n", "Couldn't allocate memory for batch");
+                ok = false;
+            }
+        }
+        free(input_path);
+        free(output_path);
+    }
+    closedir(directory);
+    // process the files in a predictable order
+    if(ok && (batch->count > 0)) {
+        qsort(
+            batch->items, batch->count, sizeof(struct batch_item_t),
+            compare_batch_items
+        );
+    }
+    return ok;
+}
+
+/*
+ * private function, worker thread entry point for batch runs.
+ * takes jobs from the batch one at a time and runs them until there are none
+ * left. failures are reported per job and don't stop the worker.
+ */
+static void* batch_worker(void* batch_void_pointer) {
+    struct batch_t* batch = (struct batch_t*)batch_void_pointer;
+    while(true) {
+        // claim the next job, if any are left
+        pthread_mutex_lock(&batch->lock);
+        size_t index = batch->next;
+        if(index < batch->count) {
+            batch->next++;
+        }
+        pthread_mutex_unlock(&batch->lock);
+        if(index >= batch->count) {
+            return NULL;
+        }
+        // run the job with the shared options but its own input and output
+        struct batch_item_t* item = &batch->items[index];
+        struct run_options_t options = *batch->options;
+        options.input_string = "";
+        options.input_file_path = item->input_file_path;
+        options.output_file_path = item->output_file_path;
+        // jobs run one at a time then, each with statistics of its own
+        char* stats_path = NULL;
+        if(
+            (options.stats_file_path != NULL) &&
+            (strcmp(options.stats_file_path, "") != 0)
+        ) {
+            stats_path = frame_path(options.stats_file_path, index);
+            if(stats_path == NULL) {
+                fprintf(stderr, "%s\n", "Couldn't allocate memory for batch");
+                item->ok = false;
+                continue;
+            }
+            options.stats_file_path = stats_path;
+        }
+        item->ok = run(&options, &item->stopped);
+        free(stats_path);
+        if(!item->ok) {
+            fprintf(
+                stderr, "Batch job failed: %s -> %s\n",
+                item->input_file_path, item->output_file_path
+            );
+        }
+    }
+}
+
+/*
+ * private function, returns the extension to name a job's output with when sxbp
+ * names it, by the format it'll be in
+ */
+static const char* output_extension(const struct run_options_t* options) {
+    if(!options->render) {
+        return ".sxp";
+    }
+    return (
+        (strcmp(options->image_format, "png") == 0) ? ".png" :
+        (strcmp(options->image_format, "svg") == 0) ? ".svg" :
+        ".pbm"
+    );
+}
+
+/*
+ * private function, runs a batch of jobs on a pool of worker threads, all with
+ * the same options. the batch is either a manifest file listing input and
+ * output paths, or a directory of input files in which case the output path in
+ * the options is the directory to write the outputs to. stopped is set to
+ * whether any job was stopped early.
+ * returns true if every job succeeded, false if any failed.
+ */
+static bool run_batch(
+    const struct run_options_t* options, const char* batch_path, int jobs,
+    bool* stopped
+) {
+    *stopped = false;
+    struct batch_t batch = {
+        .items = NULL, .count = 0, .capacity = 0, .next = 0,
+        .options = options,
+    };
+    // work out whether we've been given a directory or a manifest file
+    struct stat batch_stat;
+    if(stat(batch_path, &batch_stat) != 0) {
+        fprintf(
+            stderr, "Couldn't find batch manifest or directory: %s\n",
+            batch_path
+        );
+        return false;
+    }
+    bool ok = false;
+    if(S_ISDIR(batch_stat.st_mode)) {
+        if(strcmp(options->output_file_path, "") == 0) {
+            fprintf(
+                stderr, "%s\n",
+                "An output directory must be given for a batch directory"
+            );
+        } else {
+            ok = read_batch_directory(
+                batch_path, options->output_file_path,
+                output_extension(options), &batch
+            );
+        }
+    } else {
+        ok = read_batch_manifest(batch_path, &batch);
+    }
+    if(ok) {
+        // don't start more workers than there are jobs
+        size_t worker_count = (jobs < 1) ? 1 : (size_t)jobs;
+        if(worker_count > batch.count) {
+            worker_count = (batch.count == 0) ? 1 : batch.count;
+        }
+        pthread_mutex_init(&batch.lock, NULL);
+        /*
+         * the calling thread is one of the workers, so start one fewer threads
+         * than asked for. if a thread can't be started, carry on with fewer.
+         */
+        pthread_t* workers = calloc(worker_count, sizeof(pthread_t));
+        size_t started = 0;
+        if(workers != NULL) {
+            while(
+                (started < worker_count - 1) &&
+                (pthread_create(
+                    &workers[started], NULL, batch_worker, &batch
+                ) == 0)
+            ) {
+                started++;
+            }
+        }
+        batch_worker(&batch);
+        for(size_t i = 0; i < started; i++) {
+            pthread_join(workers[i], NULL);
+        }
+        free(workers);
+        pthread_mutex_destroy(&batch.lock);
+        // report how the batch went as a whole
+        size_t failed = 0;
+        for(size_t i = 0; i < batch.count; i++) {
+            if(!batch.items[i].ok) {
+                failed++;
+            }
+            if(batch.items[i].stopped) {
+                *stopped = true;
+            }
+        }
+        if(failed > 0) {
+            fprintf(
+                stderr, "%zu of %zu batch jobs failed\n", failed, batch.count
+            );
+            ok = false;
+        }
+    }
+    // free batch
+    for(size_t i = 0; i < batch.count; i++) {
+        free(batch.items[i].input_file_path);
+        free(batch.items[i].output_file_path);
+    }
+    free(batch.items);
+    return ok;
+}
+
+// how long in seconds an idle queue worker waits before looking for jobs again
+#define QUEUE_POLL_INTERVAL 1
+
+/*
+ * private structure, a worker taking jobs from a queue directory. the other
+ * workers sharing the directory, on this machine or any other, know it's alive
+ * by the lease file in its directory under active/, which its heartbeat thread
+ * touches a few times per lease. lease_lost and stopping are shared with that
+ * thread, so they're guarded by the lock.
+ */
+struct queue_worker_t {
+    const char* queue_dir; // directory the queue is in
+    int lease_time; // seconds a lease lasts without a heartbeat
+    unsigned long registrations; // number of times the worker has registered
+    char* name; // name of the worker, unique to its host, process and lease
+    char* directory; // the worker's own directory, under active/
+    char* lease_path; // path of the worker's lease file
+    bool lease_lost; // whether the worker's directory was taken from it
+    bool stopping; // whether the heartbeat thread has been asked to finish
+    pthread_t heartbeat; // thread touching the lease file
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // signalled when stopping is set
+};
+
+/*
+ * private function, returns a newly allocated path of the file with the given
+ * name and suffix in the given subdirectory of the queue, or NULL if memory
+ * couldn't be allocated
+ */
+static char* queue_path(
+    const char* queue_dir, const char* subdirectory, const char* name,
+    const char* suffix
+) {
+    size_t size = (
+        strlen(queue_dir) + strlen(subdirectory) + strlen(name) +
+        strlen(suffix) + 3
+    );
+    char* path = malloc(size);
+    if(path != NULL) {
+        snprintf(
+            path, size, "%s/%s/%s%s", queue_dir, subdirectory, name, suffix
+        );
+    }
+    return path;
+}
+
+// private function, compares two file names, for use by qsort()
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/*
+ * private function, lists the names of the files in the given directory in
+ * order, skipping hidden ones. a directory which doesn't exist is empty.
+ * the names and the list are allocated and must be freed by the caller.
+ * returns true on success, false on failure.
+ */
+static bool list_directory(const char* path, char*** names, size_t* count) {
+    *names = NULL;
+    *count = 0;
+    DIR* directory = opendir(path);
+    if(directory == NULL) {
+        return errno == ENOENT;
+    }
+    bool ok = true;
+    size_t capacity = 0;
+    struct dirent* entry = NULL;
+    while(ok && ((entry = readdir(directory)) != NULL)) {
+        // skip hidden files, which also skips '.' and '..'
+        if(entry->d_name[0] == '.') {
+            continue;
+        }
+        if(*count == capacity) {
+            size_t new_capacity = (capacity == 0) ? 16 : capacity * 2;
+            char** new_names = realloc(*names, new_capacity * sizeof(char*));
+            if(new_names == NULL) {
+                ok = false;
+                break;
+            }
+            *names = new_names;
+            capacity = new_capacity;
+        }
+        size_t size = strlen(entry->d_name) + 1;
+        char* name = malloc(size);
+        if(name == NULL) {
+            ok = false;
+        } else {
+            memcpy(name, entry->d_name, size);
+            (*names)[(*count)++] = name;
+        }
+    }
+    closedir(directory);
+    if(ok && (*count > 0)) {
+        qsort(*names, *count, sizeof(char*), compare_names);
+    }
+    return ok;
+}
+
+// private function, frees a list of names made by list_directory()
+static void free_names(char** names, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+/*
+ * private function, removes the given file, or the given directory and
+ * everything in it. anything already gone counts as removed.
+ * returns true on success, false on failure.
+ */
+static bool remove_tree(const char* path) {
+    struct stat path_stat;
+    if(lstat(path, &path_stat) != 0) {
+        return errno == ENOENT;
+    }
+    if(!S_ISDIR(path_stat.st_mode)) {
+        return (unlink(path) == 0) || (errno == ENOENT);
+    }
+    DIR* directory = opendir(path);
+    if(directory == NULL) {
+        return errno == ENOENT;
+    }
+    bool ok = true;
+    struct dirent* entry = NULL;
+    while((entry = readdir(directory)) != NULL) {
+        if(
+            (strcmp(entry->d_name, ".") == 0) ||
+            (strcmp(entry->d_name, "..") == 0)
+        ) {
+            continue;
+        }
+        char* entry_path = join_path(path, entry->d_name);
+        ok = (entry_path != NULL) && remove_tree(entry_path) && ok;
+        free(entry_path);
+    }
+    closedir(directory);
+    return ok && ((rmdir(path) == 0) || (errno == ENOENT));
+}
+
+/*
+ * private function, stores the time the given file was last modified in
+ * seconds in modified.
+ * returns true on success, false if it couldn't be found.
+ */
+static bool modified_time(const char* path, double* modified) {
+    struct stat path_stat;
+    if(stat(path, &path_stat) != 0) {
+        return false;
+    }
+    *modified = (
+        (double)path_stat.st_mtim.tv_sec +
+        (double)path_stat.st_mtim.tv_nsec / 1e9
+    );
+    return true;
+}
+
+/*
+ * private function, renews the worker's lease by touching its lease file. it's
+ * only missing if another worker took the worker's directory over, thinking it
+ * had stopped, in which case the lease is marked as lost.
+ * returns whether the worker still holds its lease.
+ */
+static bool renew_lease(struct queue_worker_t* worker) {
+    // other errors may well pass, such as a file server being slow to answer
+    bool lost = (
+        (utimensat(AT_FDCWD, worker->lease_path, NULL, 0) != 0) &&
+        (errno == ENOENT)
+    );
+    pthread_mutex_lock(&worker->lock);
+    worker->lease_lost = worker->lease_lost || lost;
+    lost = worker->lease_lost;
+    pthread_mutex_unlock(&worker->lock);
+    return !lost;
+}
+
+/*
+ * private function, entry point of a queue worker's heartbeat thread, which
+ * renews its lease four times per lease time, so that a few missed heartbeats
+ * don't lose it
+ */
+static void* queue_heartbeat(void* worker_void_pointer) {
+    struct queue_worker_t* worker = (struct queue_worker_t*)worker_void_pointer;
+    pthread_mutex_lock(&worker->lock);
+    while(!worker->stopping && !worker->lease_lost) {
+        struct timespec wake;
+        clock_gettime(CLOCK_REALTIME, &wake);
+        wake.tv_sec += worker->lease_time / 4;
+        wake.tv_nsec += (worker->lease_time % 4) * 250000000L;
+        if(wake.tv_nsec >= 1000000000L) {
+            wake.tv_sec++;
+            wake.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&worker->changed, &worker->lock, &wake);
+        if(!worker->stopping) {
+            pthread_mutex_unlock(&worker->lock);
+            renew_lease(worker);
+            pthread_mutex_lock(&worker->lock);
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+// private function, returns whether the queue worker has lost its lease
+static bool lease_lost(struct queue_worker_t* worker) {
+    pthread_mutex_lock(&worker->lock);
+    bool lost = worker->lease_lost;
+    pthread_mutex_unlock(&worker->lock);
+    return lost;
+}
+
+/*
+ * private function, should_stop function of queue jobs. once another worker
+ * has taken the job over there's no point carrying on with it.
+ */
+static enum stop_request_t check_queue_lease(void* worker_void_pointer) {
+    struct queue_worker_t* worker = (struct queue_worker_t*)worker_void_pointer;
+    return lease_lost(worker) ? STOP_CANCEL : STOP_NONE;
+}
+
+/*
+ * private function, registers the queue worker under a new name, making its
+ * directory and lease file and starting its heartbeat.
+ * returns true on success, false on failure.
+ */
+static bool register_queue_worker(struct queue_worker_t* worker) {
+    // the name only has to be unique, so a truncated host name will do
+    char host[64] = "localhost";
+    gethostname(host, sizeof(host));
+    host[sizeof(host) - 1] = '\0';
+    char name[sizeof(host) + 48];
+    snprintf(
+        name, sizeof(name), "%s.%ld.%lu", host, (long)getpid(),
+        worker->registrations++
+    );
+    worker->name = malloc(strlen(name) + 1);
+    worker->directory = queue_path(worker->queue_dir, "active", name, "");
+    worker->lease_path = queue_path(
+        worker->queue_dir, "active", name, "/lease"
+    );
+    char* job_directory = queue_path(
+        worker->queue_dir, "active", name, "/job"
+    );
+    bool ok = (
+        (worker->name != NULL) && (worker->directory != NULL) &&
+        (worker->lease_path != NULL) && (job_directory != NULL) &&
+        (mkdir(worker->directory, 0777) == 0) &&
+        (mkdir(job_directory, 0777) == 0)
+    );
+    free(job_directory);
+    if(ok) {
+        strcpy(worker->name, name);
+        int descriptor = open(worker->lease_path, O_WRONLY | O_CREAT, 0666);
+        ok = (descriptor != -1);
+        if(ok) {
+            close(descriptor);
+        }
+    }
+    worker->lease_lost = false;
+    worker->stopping = false;
+    if(
+        !ok ||
+        (pthread_create(&worker->heartbeat, NULL, queue_heartbeat, worker) != 0)
+    ) {
+        fprintf(stderr, "%s\n", "Couldn't register as a queue worker");
+        if(worker->directory != NULL) {
+            remove_tree(worker->directory);
+        }
+        free(worker->name);
+        free(worker->directory);
+        free(worker->lease_path);
+        worker->name = NULL;
+        worker->directory = NULL;
+        worker->lease_path = NULL;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * private function, puts the job held in the given worker directory back in
+ * the queue, if there is one. its latest checkpoint, either the output written
+ * so far or the one it was carried on from, goes with it.
+ * returns true on success, false if the job couldn't be put back.
+ */
+static bool requeue_job(const char* queue_dir, const char* directory) {
+    char* job_directory = join_path(directory, "job");
+    char** names = NULL;
+    size_t count = 0;
+    bool ok = (job_directory != NULL) && list_directory(
+        job_directory, &names, &count
+    );
+    for(size_t i = 0; ok && (i < count); i++) {
+        char* checkpoint = queue_path(
+            queue_dir, "checkpoints", names[i], ".sxp"
+        );
+        char* output = join_path(directory, "output.sxp");
+        char* resume = join_path(directory, "resume.sxp");
+        char* job = join_path(job_directory, names[i]);
+        char* pending = queue_path(queue_dir, "pending", names[i], "");
+        ok = (
+            (checkpoint != NULL) && (output != NULL) && (resume != NULL) &&
+            (job != NULL) && (pending != NULL)
+        );
+        if(ok && (rename(output, checkpoint) != 0)) {
+            rename(resume, checkpoint);
+        }
+        // the checkpoint goes first, so that it's there once the job is
+        if(ok && (rename(job, pending) == 0)) {
+            fprintf(stderr, "Re-queued job: %s\n", names[i]);
+        } else {
+            fprintf(stderr, "Couldn't re-queue job: %s\n", names[i]);
+            ok = false;
+        }
+        free(checkpoint);
+        free(output);
+        free(resume);
+        free(job);
+        free(pending);
+    }
+    free_names(names, count);
+    free(job_directory);
+    return ok;
+}
+
+/*
+ * private function, puts the jobs held in the given worker directory, which
+ * this worker must own, back in the queue, then removes it. the directories of
+ * workers this one had taken over are dealt with the same way first.
+ * returns true on success, false if a job couldn't be put back, in which case
+ * the directory is left for someone to look at.
+ */
+static bool requeue_worker(const char* queue_dir, const char* directory) {
+    char* reaped_directory = join_path(directory, "reaped");
+    char** names = NULL;
+    size_t count = 0;
+    bool ok = (reaped_directory != NULL) && list_directory(
+        reaped_directory, &names, &count
+    );
+    for(size_t i = 0; ok && (i < count); i++) {
+        char* reaped = join_path(reaped_directory, names[i]);
+        ok = (reaped != NULL) && requeue_worker(queue_dir, reaped);
+        free(reaped);
+    }
+    free_names(names, count);
+    free(reaped_directory);
+    ok = ok && requeue_job(queue_dir, directory);
+    return ok && remove_tree(directory);
+}
+
+/*
+ * private function, stops the queue worker's heartbeat and frees its paths. if
+ * remove is true and the worker still has its directory, anything left in it
+ * is put back in the queue and it's removed.
+ */
+static void unregister_queue_worker(
+    struct queue_worker_t* worker, bool remove
+) {
+    pthread_mutex_lock(&worker->lock);
+    worker->stopping = true;
+    pthread_cond_signal(&worker->changed);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->heartbeat, NULL);
+    if(remove && !lease_lost(worker)) {
+        requeue_worker(worker->queue_dir, worker->directory);
+    }
+    free(worker->name);
+    free(worker->directory);
+    free(worker->lease_path);
+    worker->name = NULL;
+    worker->directory = NULL;
+    worker->lease_path = NULL;
+}
+
+/*
+ * private function, takes over the directory of every other worker whose lease
+ * has expired and puts its jobs back in the queue. a directory is taken over by
+ * renaming it into this worker's own, which only one worker can do, and which
+ * means that if this worker stops too, whoever takes over from it deals with
+ * them. leases are compared with this worker's own, touched just now, so that
+ * only the clock of the machine the queue is on matters.
+ * returns false if this worker has lost its own lease, true otherwise.
+ */
+static bool reap_expired_workers(struct queue_worker_t* worker) {
+    double now = 0.0;
+    if(!renew_lease(worker) || !modified_time(worker->lease_path, &now)) {
+        return false;
+    }
+    char* active_directory = queue_path(worker->queue_dir, "active", "", "");
+    char* reaped_directory = join_path(worker->directory, "reaped");
+    char** names = NULL;
+    size_t count = 0;
+    if(
+        (active_directory != NULL) && (reaped_directory != NULL) &&
+        list_directory(active_directory, &names, &count)
+    ) {
+        for(size_t i = 0; i < count; i++) {
+            if(strcmp(names[i], worker->name) == 0) {
+                continue;
+            }
+            char* directory = join_path(active_directory, names[i]);
+            char* lease = queue_path(
+                worker->queue_dir, "active", names[i], "/lease"
+            );
+            char* reaped = join_path(reaped_directory, names[i]);
+            double heartbeat = 0.0;
+            if(
+                (directory != NULL) && (lease != NULL) && (reaped != NULL) &&
+                // a worker caught registering has no lease file yet
+                (
+                    modified_time(lease, &heartbeat) ||
+                    modified_time(directory, &heartbeat)
+                ) &&
+                (now - heartbeat > worker->lease_time) &&
+                ((mkdir(reaped_directory, 0777) == 0) || (errno == EEXIST)) &&
+                (rename(directory, reaped) == 0)
+            ) {
+                fprintf(
+                    stderr, "Lease of queue worker expired: %s\n", names[i]
+                );
+                requeue_worker(worker->queue_dir, reaped);
+            }
+            free(directory);
+            free(lease);
+            free(reaped);
+        }
+    }
+    free_names(names, count);
+    free(active_directory);
+    free(reaped_directory);
+    return true;
+}
+
+/*
+ * private function, claims the first job waiting in the queue by renaming it
+ * into the worker's own directory, which only one worker can do.
+ * returns the job's name, which must be freed by the caller, or NULL if there
+ * are no jobs waiting.
+ */
+static char* claim_job(const struct queue_worker_t* worker) {
+    char* pending_directory = queue_path(worker->queue_dir, "pending", "", "");
+    char** names = NULL;
+    size_t count = 0;
+    char* claimed = NULL;
+    if(
+        (pending_directory != NULL) &&
+        list_directory(pending_directory, &names, &count)
+    ) {
+        for(size_t i = 0; (claimed == NULL) && (i < count); i++) {
+            char* pending = join_path(pending_directory, names[i]);
+            char* job = queue_path(
+                worker->queue_dir, "active", worker->name, "/job/"
+            );
+            char* job_path = (job != NULL) ? join_path(job, names[i]) : NULL;
+            // if it's gone, another worker got there first
+            if(
+                (pending != NULL) && (job_path != NULL) &&
+                (rename(pending, job_path) == 0)
+            ) {
+                claimed = names[i];
+                names[i] = NULL;
+            }
+            free(pending);
+            free(job);
+            free(job_path);
+        }
+    }
+    free_names(names, count);
+    free(pending_directory);
+    return claimed;
+}
+
+/*
+ * private function, returns whether the queue might still have work for this
+ * worker: jobs waiting, or jobs held by other workers which could yet be put
+ * back if their workers stop
+ */
+static bool queue_busy(const struct queue_worker_t* worker) {
+    char* active_directory = queue_path(worker->queue_dir, "active", "", "");
+    char* pending_directory = queue_path(worker->queue_dir, "pending", "", "");
+    char** names = NULL;
+    size_t count = 0;
+    // assume the worst if we can't tell
+    bool busy = true;
+    if(
+        (active_directory != NULL) && (pending_directory != NULL) &&
+        list_directory(active_directory, &names, &count)
+    ) {
+        busy = false;
+        for(size_t i = 0; !busy && (i < count); i++) {
+            char* job = queue_path(
+                worker->queue_dir, "active", names[i], "/job"
+            );
+            char* reaped = queue_path(
+                worker->queue_dir, "active", names[i], "/reaped"
+            );
+            char** held = NULL;
+            size_t held_count = 0;
+            busy = (job == NULL) || (reaped == NULL) || (
+                list_directory(job, &held, &held_count) && (held_count > 0)
+            );
+            free_names(held, held_count);
+            held = NULL;
+            held_count = 0;
+            busy = busy || !list_directory(reaped, &held, &held_count) || (
+                held_count > 0
+            );
+            free_names(held, held_count);
+            free(job);
+            free(reaped);
+        }
+        free_names(names, count);
+        names = NULL;
+        count = 0;
+        // a job may have been put back since we last looked
+        busy = busy || !list_directory(pending_directory, &names, &count) || (
+            count > 0
+        );
+    }
+    free_names(names, count);
+    free(active_directory);
+    free(pending_directory);
+    return busy;
+}
+
+/*
+ * private function, runs the claimed job of the given name with the given
+ * options, carrying on from its checkpoint if it has one. when done, its output
+ * is published to done/, or its input moved to failed/ if it failed, or it's
+ * put back in the queue with its progress if it was stopped early. stopped is
+ * set to whether it was.
+ * returns false if the job failed, true otherwise.
+ */
+static bool run_queue_job(
+    struct queue_worker_t* worker, const struct run_options_t* options,
+    const char* name, bool* stopped
+) {
+    const char* extension = output_extension(options);
+    char* job = queue_path(worker->queue_dir, "active", worker->name, "/job/");
+    char* job_path = (job != NULL) ? join_path(job, name) : NULL;
+    char* output = queue_path(
+        worker->queue_dir, "active", worker->name, "/output"
+    );
+    char* output_path = (output != NULL) ? malloc(strlen(output) + 5) : NULL;
+    char* resume_path = join_path(worker->directory, "resume.sxp");
+    char* checkpoint_path = queue_path(
+        worker->queue_dir, "checkpoints", name, ".sxp"
+    );
+    char* done_path = queue_path(worker->queue_dir, "done", name, extension);
+    char* failed_path = queue_path(worker->queue_dir, "failed", name, "");
+    bool ok = (
+        (job_path != NULL) && (output_path != NULL) &&
+        (resume_path != NULL) && (checkpoint_path != NULL) &&
+        (done_path != NULL) && (failed_path != NULL)
+    );
+    *stopped = false;
+    if(!ok) {
+        fprintf(stderr, "%s\n", "Couldn't allocate memory for queue job");
+    } else {
+        // the output keeps its extension, which may decide its format
+        sprintf(output_path, "%s%s", output, extension);
+        struct run_options_t job_options = *options;
+        job_options.input_string = "";
+        job_options.input_file_path = job_path;
+        job_options.output_file_path = output_path;
+        job_options.should_stop = check_queue_lease;
+        job_options.stop_context = worker;
+        // a job put back in the queue may have left a checkpoint to carry on
+        if(rename(checkpoint_path, resume_path) == 0) {
+            if(options->generate && !options->render) {
+                fprintf(stderr, "Resuming job from checkpoint: %s\n", name);
+                job_options.input_file_path = resume_path;
+                job_options.prepare = false;
+            } else {
+                unlink(resume_path);
+            }
+        }
+        ok = run(&job_options, stopped);
+        if(lease_lost(worker) || !renew_lease(worker)) {
+            // it's no longer ours, whoever took it over will run it again
+            fprintf(stderr, "Lost the lease on queue job: %s\n", name);
+            ok = true;
+            *stopped = false;
+        } else if(*stopped) {
+            ok = requeue_job(worker->queue_dir, worker->directory);
+        } else if(ok && (rename(output_path, done_path) != 0)) {
+            fprintf(stderr, "Couldn't publish queue job output: %s\n", name);
+            ok = false;
+        }
+        if(!ok) {
+            fprintf(stderr, "Queue job failed: %s\n", name);
+            rename(job_path, failed_path);
+        }
+        // whatever's left of the job is done with now
+        if(!lease_lost(worker)) {
+            unlink(job_path);
+            unlink(output_path);
+            unlink(resume_path);
+        }
+    }
+    free(job);
+    free(job_path);
+    free(output);
+    free(output_path);
+    free(resume_path);
+    free(checkpoint_path);
+    free(done_path);
+    free(failed_path);
+    return ok;
+}
+
+/*
+ * private function, runs as a worker of the queue in the given directory,
+ * taking jobs from it one at a time and running them with the given options
+ * until there are none left, or a signal stops it. any number of workers can
+ * share the queue, on any machines which can see the directory. jobs held by
+ * workers which haven't renewed their lease in lease_time seconds are put back
+ * in the queue for the others. stopped is set to whether a job was stopped
+ * early.
+ * returns true if every job this worker ran succeeded, false if any failed.
+ */
+static bool run_queue(
+    const struct run_options_t* options, const char* queue_dir, int lease_time,
+    bool* stopped
+) {
+    *stopped = false;
+    // outputs are named after their jobs and kept in the queue
+    if(
+        (strcmp(options->input_file_path, "") != 0) ||
+        (strcmp(options->input_string, "") != 0) ||
+        (strcmp(options->output_file_path, "") != 0)
+    ) {
+        fprintf(
+            stderr, "%s\n", "Inputs and outputs can't be given in queue mode"
+        );
+        return false;
+    } else if(
+        (options->stats_file_path != NULL) &&
+        (strcmp(options->stats_file_path, "") != 0)
+    ) {
+        fprintf(stderr, "%s\n", "Statistics can't be collected in queue mode");
+        return false;
+    } else if(options->journal) {
+        // the journal couldn't go with a checkpoint when it's put back
+        fprintf(stderr, "%s\n", "Journals can't be used in queue mode");
+        return false;
+    } else if((options->view.tile_width > 0) || (options->shard_size > 0)) {
+        // only single files are published
+        fprintf(stderr, "%s\n", "Tiles and shards can't be made in queue mode");
+        return false;
+    }
+    static const char* const subdirectories[] = {
+        "", "pending", "active", "checkpoints", "done", "failed",
+    };
+    for(size_t i = 0; i < sizeof(subdirectories) / sizeof(char*); i++) {
+        char* path = queue_path(queue_dir, subdirectories[i], "", "");
+        bool made = (
+            (path != NULL) && ((mkdir(path, 0777) == 0) || (errno == EEXIST))
+        );
+        free(path);
+        if(!made) {
+            fprintf(stderr, "Couldn't create queue directory: %s\n", queue_dir);
+            return false;
+        }
+    }
+    struct queue_worker_t worker = {
+        .queue_dir = queue_dir, .lease_time = lease_time, .registrations = 0,
+        .name = NULL, .directory = NULL, .lease_path = NULL,
+    };
+    pthread_mutex_init(&worker.lock, NULL);
+    pthread_cond_init(&worker.changed, NULL);
+    bool registered = register_queue_worker(&worker);
+    size_t job_count = 0;
+    size_t failed = 0;
+    while(registered && !stop_signalled()) {
+        if(!reap_expired_workers(&worker)) {
+            // carry on under a new name, our jobs have been taken care of
+            fprintf(
+                stderr, "Lost the lease of queue worker: %s\n", worker.name
+            );
+            unregister_queue_worker(&worker, false);
+            registered = register_queue_worker(&worker);
+            continue;
+        }
+        char* name = claim_job(&worker);
+        if(name != NULL) {
+            bool job_stopped = false;
+            job_count++;
+            if(!run_queue_job(&worker, options, name, &job_stopped)) {
+                failed++;
+            }
+            *stopped = *stopped || job_stopped;
+            free(name);
+        } else if(queue_busy(&worker)) {
+            sleep(QUEUE_POLL_INTERVAL);
+        } else {
+            break;
+        }
+    }
+    if(registered) {
+        unregister_queue_worker(&worker, true);
+    }
+    pthread_cond_destroy(&worker.changed);
+    pthread_mutex_destroy(&worker.lock);
+    if(failed > 0) {
+        fprintf(stderr, "%zu of %zu queue jobs failed\n", failed, job_count);
+    }
+    return registered && (failed == 0);
+}
+
+/*
+ * private function, parses a tile size given as WIDTHxHEIGHT in pixels.
+ * returns true on success and false on failure.
+ */
+static bool parse_tile_size(
+    const char* string, uint32_t* width, uint32_t* height
+) {
+    char extra;
+    return (
+        (string[0] >= '0') && (string[0] <= '9') &&
+        (
+            sscanf(
+                string, "%" SCNu32 "x%" SCNu32 "%c", width, height, &extra
+            ) == 2
+        ) &&
+        (*width > 0) && (*height > 0)
+    );
+}
+
+/*
+ * private function, parses an image scale given as 1/N (or just N).
+ * returns true on success and false on failure.
+ */
+static bool parse_scale(const char* string, uint32_t* scale) {
+    char extra;
+    if(strncmp(string, "1/", 2) == 0) {
+        string += 2;
+    }
+    return (
+        (string[0] >= '0') && (string[0] <= '9') &&
+        (sscanf(string, "%" SCNu32 "%c", scale, &extra) == 1) &&
+        (*scale > 0)
+    );
+}
+
+// number of entries in the argument table, including the end marker
+#define ARGUMENT_COUNT 40
+
+/*
+ * private structure, the command-line arguments the program understands.
+ * options collected from them point into them, so they must be kept until
+ * those options are finished with.
+ */
+struct arguments_t {
+    struct arg_lit* help; // show help
+    struct arg_lit* version; // show version
+    struct arg_lit* prepare; // prepare a spiral
+    struct arg_lit* generate; // generate the solution for a spiral's lines
+    struct arg_lit* render; // render a spiral to image
+    struct arg_file* input; // input file path
+    struct arg_file* output; // output file path
+    struct arg_str* image_format;
+    struct arg_str* sxp_format;
+    struct arg_lit* geometry;
+    struct arg_int* save_every;
+    struct arg_lit* frames;
+    struct arg_str* input_string;
+    struct arg_int* perfect_threshold;
+    struct arg_lit* perfect;
+    struct arg_int* line_limit;
+    struct arg_int* total_lines;
+    struct arg_file* batch; // batch manifest or directory
+    struct arg_int* jobs;
+    struct arg_lit* journal;
+    struct arg_lit* resume;
+    struct arg_file* stats;
+    struct arg_int* progress;
+    struct arg_lit* direct_io;
+    struct arg_str* tile;
+    struct arg_str* scale;
+    struct arg_int* png_level;
+    struct arg_str* cache_dir;
+    struct arg_int* cache_size;
+    struct arg_int* shard_size;
+    struct arg_int* deadline;
+    struct arg_int* max_rss;
+    struct arg_int* target_time;
+    struct arg_str* schedule;
+    struct arg_file* serve; // socket path to serve requests on
+    struct arg_int* queue_size;
+    struct arg_str* queue_dir; // directory to take queued jobs from
+    struct arg_int* lease;
+    struct arg_end* end; // argtable boilerplate
+    void* argtable[ARGUMENT_COUNT];
+};
+
+/*
+ * private function, builds the argument table and sets the default value of
+ * each argument.
+ * returns true on success, false if any of it couldn't be allocated.
+ */
+static bool make_arguments(struct arguments_t* arguments) {
+    arguments->help = arg_lit0("h","help", "show this help and exit");
+    arguments->version = arg_lit0(
+        "v", "version", "show version of program and library, then exit"
+    );
+    // flag for if we want to prepare a spiral
+    arguments->prepare = arg_lit0(
+        "p", "prepare",
+        "prepare a spiral from raw binary data"
+    );
+    // flag for if we want to generate the solution for a spiral's line lengths
+    arguments->generate = arg_lit0(
+        "g", "generate",
+        "generate the lengths of a spiral's lines"
+    );
+    // flag for if we want to render a spiral to imagee
+    arguments->render = arg_lit0(
+        "r", "render", "render a spiral to an image"
+    );
+    arguments->input = arg_file0(
+        "i", "input", NULL, "input file path (- for stdin)"
+    );
+    arguments->output = arg_filen(
+        "o", "output", NULL, 0, MAX_OUTPUTS,
+        "output file path (- for stdout), give more to write several formats"
+    );
+    arguments->image_format = arg_str0(
+        "f", "image-format", "FORMAT",
+        "which image format to render to (pbm/png/svg)"
+    );
+    arguments->sxp_format = arg_str0(
+        NULL, "sxp-format", "VERSION",
+        "which format to write sxp files in (v1/v2/v2z)"
+    );
+    arguments->geometry = arg_lit0(
+        NULL, "geometry",
+        "store co-ords and bounds in v2 sxp files, so they load faster"
+    );
+    arguments->save_every = arg_int0(
+        "s", "save-every", NULL,
+        "save to file every this number of lines solved"
+    );
+    arguments->frames = arg_lit0(
+        NULL, "frames", "save each image checkpoint to a numbered file"
+    );
+    arguments->input_string = arg_str0(
+        "S", "string", "STRING",
+        "use the given STRING as input data for the spiral"
+    );
+    arguments->perfect_threshold = arg_int0(
+        "d", "perfection-threshold", NULL, "set optimisation threshold"
+    );
+    arguments->perfect = arg_lit0(
+        "D", "disable-perfection", "allow unlimited optimisations"
+    );
+    arguments->line_limit = arg_int0(
+        "l", "line-limit", NULL,
+        "plot this many more lines than currently solved"
+    );
+    arguments->total_lines = arg_int0(
+        "t", "total-lines", NULL, "total number of lines to plot to"
+    );
+    arguments->batch = arg_file0(
+        "b", "batch", NULL,
+        "run the jobs in a manifest file, or one per file in a directory"
+    );
+    arguments->jobs = arg_int0(
+        "j", "jobs", NULL, "number of batch jobs to run in parallel"
+    );
+    arguments->journal = arg_lit0(
+        NULL, "journal",
+        "save only changed lines to a journal next to the output file"
+    );
+    arguments->resume = arg_lit0(
+        NULL, "resume", "replay the input spiral's journal when loading it"
+    );
+    arguments->stats = arg_file0(
+        NULL, "stats", NULL, "write timing and solver statistics as JSON"
+    );
+    arguments->progress = arg_int0(
+        NULL, "progress", NULL,
+        "print solving progress every this number of seconds"
+    );
+    arguments->direct_io = arg_lit0(
+        NULL, "direct-io", "write output bypassing the page cache if possible"
+    );
+    arguments->tile = arg_str0(
+        NULL, "tile", "WxH", "render to a grid of tiles of WxH pixels"
+    );
+    arguments->scale = arg_str0(
+        NULL, "scale", "1/N", "render at 1/N of full size"
+    );
+    arguments->png_level = arg_int0(
+        NULL, "png-level", NULL,
+        "compression level of PNG images, 0 (fastest) to 9 (smallest)"
+    );
+    arguments->cache_dir = arg_str0(
+        NULL, "cache-dir", "DIR", "reuse spirals solved before, cached in DIR"
+    );
+    arguments->cache_size = arg_int0(
+        NULL, "cache-size", NULL, "most MiB the cache can take up"
+    );
+    arguments->shard_size = arg_int0(
+        NULL, "shard-size", NULL,
+        "split the input into spirals of this many bytes, made in parallel"
+    );
+    arguments->deadline = arg_int0(
+        NULL, "deadline", NULL,
+        "stop generating after this number of seconds, saving progress"
+    );
+    arguments->max_rss = arg_int0(
+        NULL, "max-rss", NULL,
+        "stop generating once using this many MiB of memory, saving progress"
+    );
+    arguments->target_time = arg_int0(
+        NULL, "target-time", NULL,
+        "adapt the perfection threshold to generate in this many seconds"
+    );
+    arguments->schedule = arg_str0(
+        NULL, "schedule", "LIST",
+        "generate with the perfection schedule LIST, as LINE:THRESHOLD,..."
+    );
+    arguments->serve = arg_file0(
+        NULL, "serve", NULL, "run as a daemon taking jobs on this unix socket"
+    );
+    arguments->queue_size = arg_int0(
+        NULL, "queue-size", NULL, "most jobs the daemon keeps waiting to run"
+    );
+    arguments->queue_dir = arg_str0(
+        NULL, "queue-dir", "DIR",
+        "work on the jobs queued in DIR, alongside any other workers"
+    );
+    arguments->lease = arg_int0(
+        NULL, "lease", NULL,
+        "seconds a queue worker's jobs are held for without a heartbeat"
+    );
+    arguments->end = arg_end(20);
+    void* argtable[ARGUMENT_COUNT] = {
+        arguments->help, arguments->version,
+        arguments->prepare, arguments->generate, arguments->render,
+        arguments->input, arguments->output, arguments->image_format,
+        arguments->sxp_format, arguments->geometry,
+        arguments->save_every, arguments->frames, arguments->input_string,
+        arguments->perfect_threshold, arguments->perfect,
+        arguments->line_limit, arguments->total_lines,
+        arguments->batch, arguments->jobs, arguments->journal,
+        arguments->resume, arguments->stats, arguments->progress,
+        arguments->direct_io, arguments->tile, arguments->scale,
+        arguments->png_level, arguments->cache_dir, arguments->cache_size,
+        arguments->shard_size, arguments->deadline, arguments->max_rss,
+        arguments->target_time, arguments->schedule, arguments->serve,
+        arguments->queue_size, arguments->queue_dir, arguments->lease,
+        arguments->end,
+    };
+    memcpy(arguments->argtable, argtable, sizeof(argtable));
+    // check argtable members were allocated successfully
+    if(arg_nullcheck(arguments->argtable) != 0) {
+        return false;
+    }
+    // set default value of perfect_threshold argument
+    arguments->perfect_threshold->ival[0] = 1;
+    // set default value of line_limit, total_lines and save_every arguments
+    arguments->line_limit->ival[0] = -1;
+    arguments->total_lines->ival[0] = -1;
+    arguments->save_every->ival[0] = -1;
+    // progress isn't printed unless asked for
+    arguments->progress->ival[0] = 0;
+    // the same level libpng deflates at by default
+    arguments->png_level->ival[0] = Z_DEFAULT_COMPRESSION;
+    // a gigabyte of cache by default
+    arguments->cache_size->ival[0] = 1024;
+    // inputs are one spiral unless asked to be sharded
+    arguments->shard_size->ival[0] = 0;
+    // runs aren't limited unless asked to be
+    arguments->deadline->ival[0] = 0;
+    arguments->max_rss->ival[0] = 0;
+    // nor is the perfection threshold adapted
+    arguments->target_time->ival[0] = 0;
+    // run one batch job per online processor by default
+    long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+    arguments->jobs->ival[0] = (processor_count > 0) ? (int)processor_count : 1;
+    // a few jobs waiting per processor is plenty to keep them all busy
+    arguments->queue_size->ival[0] = 4 * arguments->jobs->ival[0];
+    // long enough that a busy or slow file server doesn't lose anyone's jobs
+    arguments->lease->ival[0] = 60;
+    return true;
+}
+
+// private function, frees the argument table
+static void free_arguments(struct arguments_t* arguments) {
+    arg_freetable(arguments->argtable, ARGUMENT_COUNT);
+}
+
+/*
+ * private function, parses the given command-line into the arguments and
+ * collects the options to run with from them. help and the version are printed
+ * to out as asked for, and errors to err.
+ * returns -1 if the program should carry on and run, otherwise the status code
+ * it should exit with.
+ */
+static int parse_arguments(
+    struct arguments_t* arguments, int argc, char* argv[],
+    struct run_options_t* options, FILE* out, FILE* err
+) {
+    const char* program_name = "sxbp";
+    // status code initially set to -1
+    int status_code = -1;
+    // parse arguments
+    int count_errors = arg_parse(argc, argv, arguments->argtable);
+    // if we asked for the version, show it
+    if(arguments->version->count > 0) {
+        fprintf(
+            out, "%s %s (using libsxbp %s)\n",
+            program_name, SXBP_VERSION_STRING, LIB_SXBP_VERSION.string
+        );
+        status_code = 0;
+    }
+    // if parser returned any errors, display them and set return code to 1
+    if(count_errors > 0) {
+        arg_print_errors(err, arguments->end, program_name);
+        status_code = 1;
+    }
+    // work out how rendered images are to be laid out
+    struct render_view_t view = {
+        .scale = 1, .tile_width = 0, .tile_height = 0,
+        // batch jobs already keep the processors busy, so render tiles in turn
+        .jobs = (arguments->batch->count > 0) ? 1 : arguments->jobs->ival[0],
+        .png_level = arguments->png_level->ival[0],
+    };
+    if(
+        (arguments->tile->count > 0) &&
+        !parse_tile_size(
+            arguments->tile->sval[0], &view.tile_width, &view.tile_height
+        )
+    ) {
+        fprintf(
+            err, "Invalid tile size: '%s'\n", arguments->tile->sval[0]
+        );
+        status_code = 1;
+    }
+    if(
+        (arguments->scale->count > 0) &&
+        !parse_scale(arguments->scale->sval[0], &view.scale)
+    ) {
+        fprintf(err, "Invalid scale: '%s'\n", arguments->scale->sval[0]);
+        status_code = 1;
+    }
+    if(
+        (arguments->png_level->count > 0) &&
+        (
+            (arguments->png_level->ival[0] < 0) ||
+            (arguments->png_level->ival[0] > 9)
+        )
+    ) {
+        fprintf(err, "%s\n", "PNG level must be from 0 to 9");
+        status_code = 1;
+    }
+    if(arguments->cache_size->ival[0] < 0) {
+        fprintf(err, "%s\n", "Cache size can't be negative");
+        status_code = 1;
+    }
+    if(arguments->shard_size->ival[0] < 0) {
+        fprintf(err, "%s\n", "Shard size can't be negative");
+        status_code = 1;
+    }
+    if(arguments->deadline->ival[0] < 0) {
+        fprintf(err, "%s\n", "Deadline can't be negative");
+        status_code = 1;
+    }
+    if(arguments->max_rss->ival[0] < 0) {
+        fprintf(err, "%s\n", "Memory budget can't be negative");
+        status_code = 1;
+    }
+    if(arguments->target_time->ival[0] < 0) {
+        fprintf(err, "%s\n", "Target time can't be negative");
+        status_code = 1;
+    }
+    if(arguments->queue_size->ival[0] < 1) {
+        fprintf(err, "%s\n", "Queue size must be at least 1");
+        status_code = 1;
+    }
+    if(arguments->lease->ival[0] < 1) {
+        fprintf(err, "%s\n", "Lease must be at least 1 second");
+        status_code = 1;
+    }
+    // set return code to 0 if we asked for help
+    if(arguments->help->count > 0) {
+        status_code = 0;
+    }
+    // display usage information if we asked for help or got arguments wrong
+    if((count_errors > 0) || (arguments->help->count > 0)) {
+        fprintf(out, "Usage: %s", program_name);
+        arg_print_syntax(out, arguments->argtable, "\n");
+        arg_print_glossary(out, arguments->argtable, "  %-32s %s\n");
+    }
+    /*
+     * a target time without a threshold starts from the slowest level, as
+     * starting from the default threshold would leave it nothing to pick from
+     */
+    bool perfect = (
+        (arguments->perfect->count == 0) && (
+            (arguments->target_time->ival[0] <= 0) ||
+            (arguments->perfect_threshold->count > 0)
+        )
+    );
+    // collect options from command-line
+    *options = (struct run_options_t){
+        .prepare = (arguments->prepare->count > 0) ? true : false,
+        .generate = (arguments->generate->count > 0) ? true : false,
+        .render = (arguments->render->count > 0) ? true : false,
+        .perfect = perfect,
+        .perfect_threshold = arguments->perfect_threshold->ival[0],
+        .line_limit = arguments->line_limit->ival[0],
+        .total_lines = arguments->total_lines->ival[0],
+        .save_every = arguments->save_every->ival[0],
+        .journal = (arguments->journal->count > 0) ? true : false,
+        .resume = (arguments->resume->count > 0) ? true : false,
+        .image_format = arguments->image_format->sval[0],
+        .sxp_format = arguments->sxp_format->sval[0],
+        .store_geometry = (arguments->geometry->count > 0) ? true : false,
+        .frames = (arguments->frames->count > 0) ? true : false,
+        .input_string = arguments->input_string->sval[0],
+        .input_file_path = *arguments->input->filename,
+        .output_file_path = arguments->output->filename[0],
+        .extra_output_paths = arguments->output->filename + 1,
+        .extra_output_count = (
+            (arguments->output->count > 1) ? arguments->output->count - 1 : 0
+        ),
+        .stats_file_path = *arguments->stats->filename,
+        .progress_interval = arguments->progress->ival[0],
+        .direct_io = (arguments->direct_io->count > 0) ? true : false,
+        .view = view,
+        .cache_dir = arguments->cache_dir->sval[0],
+        .cache_size = arguments->cache_size->ival[0],
+        .shard_size = arguments->shard_size->ival[0],
+        .deadline = arguments->deadline->ival[0],
+        .max_rss = arguments->max_rss->ival[0],
+        .target_time = arguments->target_time->ival[0],
+        .schedule = arguments->schedule->sval[0],
+        .should_stop = NULL,
+        .stop_context = NULL,
+    };
+    return status_code;
+}
+
+/*
+ * largest request the daemon accepts, so that a client can't make it allocate
+ * as much memory as it likes
+ */
+#define DAEMON_MAX_MESSAGE_SIZE (256 * 1024 * 1024)
+// how often in milliseconds waiting daemon threads check whether to give up
+#define DAEMON_POLL_INTERVAL 200
+
+/*
+ * private enumeration, the tags of the fields of daemon messages. a message is
+ * a 32-bit big-endian length followed by that many bytes of fields, each of
+ * which is a one byte tag, a 32-bit big-endian length, then the value.
+ */
+enum daemon_field_t {
+    DAEMON_FIELD_ARGUMENT = 'a', // request: a command-line argument of the job
+    DAEMON_FIELD_INPUT = 'i', // request: data the job reads as stdin
+    DAEMON_FIELD_CANCEL = 'c', // request: id of a job to cancel, 64-bit
+    DAEMON_FIELD_JOB = 'j', // response: id given to a queued job, 64-bit
+    DAEMON_FIELD_STATUS = 's', // response: a daemon_status_t, one byte
+    DAEMON_FIELD_OUTPUT = 'o', // response: data the job wrote to stdout
+    DAEMON_FIELD_ERROR = 'e', // response: why a job was refused, as text
+};
+
+// private enumeration, how a request to the daemon turned out
+enum daemon_status_t {
+    DAEMON_STATUS_OK = 0, // the job ran successfully, or was cancelled
+    DAEMON_STATUS_FAILED = 1, // the job failed, or there's no job to cancel
+    DAEMON_STATUS_CANCELLED = 2, // the job was cancelled before it finished
+    DAEMON_STATUS_REFUSED = 3, // the request was invalid or the daemon stopping
+    DAEMON_STATUS_STOPPED = 4, // the job hit a limit, its output is partial
+};
+
+// private enumeration, the stages of a daemon job's life
+enum daemon_job_state_t {
+    DAEMON_JOB_QUEUED,
+    DAEMON_JOB_RUNNING,
+    DAEMON_JOB_FINISHED,
+};
+
+/*
+ * private structure, one job sent to the daemon. it belongs to the thread
+ * serving the connection it came in on, everything but the options, input and
+ * output is guarded by the daemon's lock.
+ */
+struct daemon_job_t {
+    uint64_t id; // number the job can be cancelled by
+    struct daemon_t* daemon; // daemon the job was sent to
+    uint8_t* message; // the request the job came in, which input points into
+    char** argv; // the job's command-line, which the options point into
+    struct arguments_t arguments; // parsed command-line
+    struct run_options_t options; // options to run the job with
+    sxbp_buffer_t input; // what the job reads as stdin
+    sxbp_buffer_t output; // what the job has written to stdout
+    enum daemon_job_state_t state; // how far along the job is
+    bool cancelled; // whether the job has been asked to stop
+    bool ok; // whether the job ran successfully
+    bool stopped; // whether the job was stopped early by its limits
+    struct daemon_job_t* next; // next job in the daemon's list
+};
+
+/*
+ * private structure, the state shared by the threads of the daemon: a bounded
+ * queue of jobs waiting to run, and a list of all jobs not yet finished
+ */
+struct daemon_t {
+    struct daemon_job_t** queue; // ring buffer of jobs waiting to run
+    size_t queue_capacity; // most jobs which can be waiting at once
+    size_t queue_start; // index of the job which has waited longest
+    size_t queue_count; // number of jobs waiting
+    struct daemon_job_t* jobs; // every queued or running job, to find by id
+    uint64_t next_id; // id to give the next job
+    size_t connection_count; // number of connections being served
+    bool draining; // whether the daemon is stopping, and takes no more jobs
+    pthread_mutex_t lock; // guards all of the above
+    pthread_cond_t changed; // signalled whenever any of the above changes
+};
+
+// private structure, a client connection and the daemon it's connected to
+struct daemon_connection_t {
+    struct daemon_t* daemon;
+    int descriptor;
+};
+
+// set by the signal handler when the daemon has been asked to stop
+static volatile sig_atomic_t daemon_stop_requested = 0;
+// command-lines are parsed with getopt(), which isn't thread-safe
+static pthread_mutex_t argument_parse_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// private function, signal handler asking the daemon to stop
+static void request_daemon_stop(int signal_number) {
+    (void)signal_number;
+    int saved_errno = errno;
+    daemon_stop_requested = 1;
+    errno = saved_errno;
+}
+
+/*
+ * private function, starts a daemon thread with the stop signals blocked, so
+ * that they're only ever handled by the main thread, which is the only one to
+ * look at daemon_stop_requested.
+ * returns true if the thread was started, false if not.
+ */
+static bool start_daemon_thread(
+    pthread_t* thread, const pthread_attr_t* attributes,
+    void* (*start_routine)(void*), void* argument
+) {
+    sigset_t blocked, original;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &blocked, &original);
+    bool started = (
+        pthread_create(thread, attributes, start_routine, argument) == 0
+    );
+    pthread_sigmask(SIG_SETMASK, &original, NULL);
+    return started;
+}
+
+/*
+ * private function, waits on the daemon's condition variable, but for no
+ * longer than the poll interval. must be called with the lock held.
+ */
+static void wait_for_daemon(struct daemon_t* daemon) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += DAEMON_POLL_INTERVAL * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&daemon->changed, &daemon->lock, &deadline);
+}
+
+/*
+ * private function, reads exactly size bytes from a client, giving up if the
+ * daemon starts stopping while waiting for them.
+ * returns true on success, false on failure.
+ */
+static bool receive_all(
+    struct daemon_t* daemon, int descriptor, uint8_t* bytes, size_t size
+) {
+    while(size > 0) {
+        struct pollfd poll_descriptor = { .fd = descriptor, .events = POLLIN, };
+        int ready = poll(&poll_descriptor, 1, DAEMON_POLL_INTERVAL);
+        if((ready < 0) && (errno != EINTR)) {
+            return false;
+        } else if(ready <= 0) {
+            // nothing yet, see if it's worth waiting any longer
+            pthread_mutex_lock(&daemon->lock);
+            bool draining = daemon->draining;
+            pthread_mutex_unlock(&daemon->lock);
+            if(draining) {
+                return false;
+            }
+            continue;
+        }
+        ssize_t result = recv(descriptor, bytes, size, 0);
+        if(result < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        } else if(result == 0) {
+            // the client hung up half way through
+            return false;
+        }
+        bytes += result;
+        size -= (size_t)result;
+    }
+    return true;
+}
+
+/*
+ * private function, writes all of the given bytes to a client.
+ * returns true on success, false on failure.
+ */
+static bool send_all(int descriptor, const uint8_t* bytes, size_t size) {
+    while(size > 0) {
+        // a client which hung up mustn't take the daemon down with SIGPIPE
+        ssize_t result = send(descriptor, bytes, size, MSG_NOSIGNAL);
+        if(result < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += result;
+        size -= (size_t)result;
+    }
+    return true;
+}
+
+// private structure, one field of a message to send
+struct daemon_field_value_t {
+    enum daemon_field_t tag;
+    const uint8_t* bytes;
+    size_t size;
+};
+
+/*
+ * private function, sends a message made of the given fields to a client.
+ * returns true on success, false on failure.
+ */
+static bool send_message(
+    int descriptor, const struct daemon_field_value_t* fields, size_t count
+) {
+    uint64_t size = 0;
+    for(size_t i = 0; i < count; i++) {
+        size += 5 + (uint64_t)fields[i].size;
+    }
+    if(size > UINT32_MAX) {
+        fprintf(stderr, "%s\n", "Job output is too big to send back");
+        return false;
+    }
+    uint8_t header[5];
+    store_uint32(header, (uint32_t)size);
+    if(!send_all(descriptor, header, 4)) {
+        return false;
+    }
+    for(size_t i = 0; i < count; i++) {
+        header[0] = (uint8_t)fields[i].tag;
+        store_uint32(header + 1, (uint32_t)fields[i].size);
+        if(
+            !send_all(descriptor, header, 5) ||
+            !send_all(descriptor, fields[i].bytes, fields[i].size)
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// private function, sends a message with just a status to a client
+static bool send_status(int descriptor, enum daemon_status_t status) {
+    uint8_t byte = (uint8_t)status;
+    struct daemon_field_value_t field = { DAEMON_FIELD_STATUS, &byte, 1, };
+    return send_message(descriptor, &field, 1);
+}
+
+// private function, stores a job id as 8 big-endian bytes
+static void store_job_id(uint8_t* bytes, uint64_t id) {
+    store_uint32(bytes, (uint32_t)(id >> 32));
+    store_uint32(bytes + 4, (uint32_t)id);
+}
+
+/*
+ * private function, checks whether a client has hung up, without waiting.
+ * returns true if it has, false if it's still there.
+ */
+static bool client_hung_up(int descriptor) {
+    struct pollfd poll_descriptor = { .fd = descriptor, .events = POLLIN, };
+    if(poll(&poll_descriptor, 1, 0) <= 0) {
+        return false;
+    }
+    uint8_t byte;
+    ssize_t result = recv(descriptor, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return (
+        (result == 0) ||
+        (
+            (result < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+            (errno != EINTR)
+        )
+    );
+}
+
+/*
+ * private function, should_stop function of daemon jobs, cancels the job given
+ * as the context if it's been asked to be
+ */
+static enum stop_request_t daemon_job_cancelled(void* job_void_pointer) {
+    struct daemon_job_t* job = (struct daemon_job_t*)job_void_pointer;
+    pthread_mutex_lock(&job->daemon->lock);
+    bool cancelled = job->cancelled;
+    pthread_mutex_unlock(&job->daemon->lock);
+    return cancelled ? STOP_CANCEL : STOP_NONE;
+}
+
+/*
+ * private function, cancels a job. one still queued is taken off the queue and
+ * finished there and then, one running stops before the next line it plots.
+ * must be called with the daemon's lock held.
+ */
+static void cancel_daemon_job(
+    struct daemon_t* daemon, struct daemon_job_t* job
+) {
+    job->cancelled = true;
+    if(job->state == DAEMON_JOB_QUEUED) {
+        // close the gap it leaves in the queue
+        bool found = false;
+        for(size_t i = 0; i < daemon->queue_count; i++) {
+            size_t index = (daemon->queue_start + i) % daemon->queue_capacity;
+            if(found) {
+                size_t previous = (
+                    (index + daemon->queue_capacity - 1) %
+                    daemon->queue_capacity
+                );
+                daemon->queue[previous] = daemon->queue[index];
+            } else if(daemon->queue[index] == job) {
+                found = true;
+            }
+        }
+        daemon->queue_count--;
+        job->state = DAEMON_JOB_FINISHED;
+    }
+    pthread_cond_broadcast(&daemon->changed);
+}
+
+/*
+ * private function, worker thread entry point for the daemon.
+ * runs jobs from the queue one at a time, until it's empty and the daemon is
+ * stopping.
+ */
+static void* daemon_worker(void* daemon_void_pointer) {
+    struct daemon_t* daemon = (struct daemon_t*)daemon_void_pointer;
+    pthread_mutex_lock(&daemon->lock);
+    while(true) {
+        while((daemon->queue_count == 0) && !daemon->draining) {
+            pthread_cond_wait(&daemon->changed, &daemon->lock);
+        }
+        if(daemon->queue_count == 0) {
+            // the daemon is stopping and there's nothing left to do
+            pthread_mutex_unlock(&daemon->lock);
+            return NULL;
+        }
+        // take the job which has waited longest, there's room for another now
+        struct daemon_job_t* job = daemon->queue[daemon->queue_start];
+        daemon->queue_start = (
+            (daemon->queue_start + 1) % daemon->queue_capacity
+        );
+        daemon->queue_count--;
+        job->state = DAEMON_JOB_RUNNING;
+        pthread_cond_broadcast(&daemon->changed);
+        pthread_mutex_unlock(&daemon->lock);
+        // the job's stdin and stdout are the ones sent with it
+        set_standard_buffers(&job->input, &job->output);
+        bool stopped = false;
+        bool ok = run(&job->options, &stopped);
+        set_standard_buffers(NULL, NULL);
+        pthread_mutex_lock(&daemon->lock);
+        job->ok = ok;
+        job->stopped = stopped;
+        job->state = DAEMON_JOB_FINISHED;
+        pthread_cond_broadcast(&daemon->changed);
+    }
+}
+
+// private function, frees a daemon job and everything it owns
+static void free_daemon_job(struct daemon_job_t* job) {
+    if(job->argv != NULL) {
+        free_arguments(&job->arguments);
+        free(job->argv[0]);
+    }
+    free(job->argv);
+    free(job->output.bytes);
+    free(job->message);
+    free(job);
+}
+
+/*
+ * private function, reads a job from a request message, taking ownership of
+ * the message. the fields have already been checked to be well-formed. what
+ * parsing its command-line prints, such as why it isn't valid, is put in error
+ * instead, which is set to NULL or text which must be freed by the caller.
+ * returns the job, or NULL if it couldn't be made or its command-line isn't
+ * valid for a daemon job.
+ */
+static struct daemon_job_t* make_daemon_job(
+    struct daemon_t* daemon, uint8_t* message, size_t size, char** error,
+    size_t* error_size
+) {
+    *error = NULL;
+    *error_size = 0;
+    struct daemon_job_t* job = calloc(1, sizeof(struct daemon_job_t));
+    if(job == NULL) {
+        free(message);
+        return NULL;
+    }
+    job->daemon = daemon;
+    job->message = message;
+    // count the arguments and how much room they need as strings
+    size_t argument_count = 1;
+    size_t strings_size = strlen("sxbp") + 1;
+    for(size_t offset = 0; offset < size;) {
+        uint32_t field_size = load_uint32(message + offset + 1);
+        if(message[offset] == DAEMON_FIELD_ARGUMENT) {
+            argument_count++;
+            strings_size += (size_t)field_size + 1;
+        } else if(message[offset] == DAEMON_FIELD_INPUT) {
+            job->input.bytes = message + offset + 5;
+            job->input.size = field_size;
+        }
+        offset += 5 + (size_t)field_size;
+    }
+    if(argument_count > INT_MAX) {
+        free_daemon_job(job);
+        return NULL;
+    }
+    // copy them out as strings, the program name first as arg_parse() expects
+    job->argv = calloc(argument_count + 1, sizeof(char*));
+    char* strings = (job->argv == NULL) ? NULL : malloc(strings_size);
+    if(strings == NULL) {
+        free_daemon_job(job);
+        return NULL;
+    }
+    job->argv[0] = strings;
+    strcpy(strings, "sxbp");
+    strings += strlen("sxbp") + 1;
+    size_t argc = 1;
+    for(size_t offset = 0; offset < size;) {
+        uint32_t field_size = load_uint32(message + offset + 1);
+        if(message[offset] == DAEMON_FIELD_ARGUMENT) {
+            memcpy(strings, message + offset + 5, field_size);
+            strings[field_size] = '\0';
+            job->argv[argc++] = strings;
+            strings += (size_t)field_size + 1;
+        }
+        offset += 5 + (size_t)field_size;
+    }
+    // what's printed goes back to the client rather than the daemon's output
+    FILE* messages = open_memstream(error, error_size);
+    if(messages == NULL) {
+        free_daemon_job(job);
+        return NULL;
+    }
+    // parse the command-line just as if the program had been run with it
+    int status_code = 0;
+    pthread_mutex_lock(&argument_parse_lock);
+    if(make_arguments(&job->arguments)) {
+        status_code = parse_arguments(
+            &job->arguments, (int)argc, job->argv, &job->options, messages,
+            messages
+        );
+    }
+    pthread_mutex_unlock(&argument_parse_lock);
+    bool valid = false;
+    if(
+        (status_code != -1) || (job->arguments.batch->count > 0) ||
+        (job->arguments.serve->count > 0) ||
+        (job->arguments.queue_dir->count > 0)
+    ) {
+        // asking for help or the version gets just that
+        if(status_code != 0) {
+            fprintf(messages, "%s\n", "Invalid daemon job command-line");
+        }
+    } else if(job->arguments.stats->count > 0) {
+        // CPU time and peak memory are the whole daemon's, not the job's
+        fprintf(
+            messages, "%s\n", "Statistics can't be collected by daemon jobs"
+        );
+    } else if(job->options.max_rss > 0) {
+        // memory use is the whole daemon's too, and every job shares it
+        fprintf(
+            messages, "%s\n", "A memory budget can't be used by daemon jobs"
+        );
+    } else {
+        valid = true;
+    }
+    if((fclose(messages) != 0) || !valid) {
+        free_daemon_job(job);
+        return NULL;
+    }
+    // the workers already keep the processors busy, so render tiles in turn
+    job->options.view.jobs = 1;
+    job->options.should_stop = daemon_job_cancelled;
+    job->options.stop_context = job;
+    return job;
+}
+
+/*
+ * private function, queues a job, waiting for room in the queue if it's full.
+ * returns true if the job was queued, false if the daemon is stopping.
+ */
+static bool queue_daemon_job(
+    struct daemon_t* daemon, struct daemon_job_t* job
+) {
+    pthread_mutex_lock(&daemon->lock);
+    // a full queue holds the client up until there's room, to push back on it
+    while(
+        (daemon->queue_count == daemon->queue_capacity) && !daemon->draining
+    ) {
+        pthread_cond_wait(&daemon->changed, &daemon->lock);
+    }
+    bool queued = !daemon->draining;
+    if(queued) {
+        job->id = daemon->next_id++;
+        job->state = DAEMON_JOB_QUEUED;
+        job->next = daemon->jobs;
+        daemon->jobs = job;
+        size_t index = (
+            (daemon->queue_start + daemon->queue_count) % daemon->queue_capacity
+        );
+        daemon->queue[index] = job;
+        daemon->queue_count++;
+        pthread_cond_broadcast(&daemon->changed);
+    }
+    pthread_mutex_unlock(&daemon->lock);
+    return queued;
+}
+
+/*
+ * private function, serves a job request: queues the job, tells the client its
+ * id, waits for it to finish then sends back how it went and its output.
+ * if the client hangs up while waiting, the job is cancelled.
+ */
+static void serve_job(
+    struct daemon_t* daemon, int descriptor, uint8_t* message, size_t size
+) {
+    char* error = NULL;
+    size_t error_size = 0;
+    struct daemon_job_t* job = make_daemon_job(
+        daemon, message, size, &error, &error_size
+    );
+    if((job == NULL) || !queue_daemon_job(daemon, job)) {
+        // say why, if it's the job's command-line that's wrong
+        uint8_t status = DAEMON_STATUS_REFUSED;
+        struct daemon_field_value_t fields[2] = {
+            { DAEMON_FIELD_STATUS, &status, 1, },
+            { DAEMON_FIELD_ERROR, (const uint8_t*)error, error_size, },
+        };
+        send_message(descriptor, fields, (error_size > 0) ? 2 : 1);
+        free(error);
+        if(job != NULL) {
+            free_daemon_job(job);
+        }
+        return;
+    }
+    free(error);
+    uint8_t id[8];
+    store_job_id(id, job->id);
+    struct daemon_field_value_t accepted = { DAEMON_FIELD_JOB, id, 8, };
+    bool connected = send_message(descriptor, &accepted, 1);
+    pthread_mutex_lock(&daemon->lock);
+    while(job->state != DAEMON_JOB_FINISHED) {
+        if(!connected) {
+            // nobody is waiting for the job any more
+            if(!job->cancelled) {
+                cancel_daemon_job(daemon, job);
+            }
+            pthread_cond_wait(&daemon->changed, &daemon->lock);
+        } else {
+            wait_for_daemon(daemon);
+            pthread_mutex_unlock(&daemon->lock);
+            connected = !client_hung_up(descriptor);
+            pthread_mutex_lock(&daemon->lock);
+        }
+    }
+    // it can't be cancelled by id once it's finished
+    for(struct daemon_job_t** link = &daemon->jobs; *link != NULL;) {
+        if(*link == job) {
+            *link = job->next;
+        } else {
+            link = &(*link)->next;
+        }
+    }
+    pthread_mutex_unlock(&daemon->lock);
+    if(connected) {
+        uint8_t status = (uint8_t)(
+            (job->ok && job->stopped) ? DAEMON_STATUS_STOPPED :
+            job->ok ? DAEMON_STATUS_OK :
+            job->cancelled ? DAEMON_STATUS_CANCELLED : DAEMON_STATUS_FAILED
+        );
+        struct daemon_field_value_t fields[2] = {
+            { DAEMON_FIELD_STATUS, &status, 1, },
+            { DAEMON_FIELD_OUTPUT, job->output.bytes, job->output.size, },
+        };
+        send_message(descriptor, fields, (job->output.size > 0) ? 2 : 1);
+    }
+    free_daemon_job(job);
+}
+
+// private function, serves a request to cancel the job with the given id
+static void serve_cancel(
+    struct daemon_t* daemon, int descriptor, const uint8_t* id_bytes
+) {
+    uint64_t id = ((uint64_t)load_uint32(id_bytes) << 32) |
+        load_uint32(id_bytes + 4);
+    bool found = false;
+    pthread_mutex_lock(&daemon->lock);
+    for(struct daemon_job_t* job = daemon->jobs; job != NULL; job = job->next) {
+        if((job->id == id) && (job->state != DAEMON_JOB_FINISHED)) {
+            cancel_daemon_job(daemon, job);
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&daemon->lock);
+    send_status(descriptor, found ? DAEMON_STATUS_OK : DAEMON_STATUS_FAILED);
+}
+
+/*
+ * private function, connection thread entry point for the daemon.
+ * reads one request from the client, serves it, then hangs up.
+ */
+static void* serve_connection(void* connection_void_pointer) {
+    struct daemon_connection_t* connection = connection_void_pointer;
+    struct daemon_t* daemon = connection->daemon;
+    int descriptor = connection->descriptor;
+    free(connection);
+    uint8_t header[4];
+    uint8_t* message = NULL;
+    size_t size = 0;
+    bool ok = receive_all(daemon, descriptor, header, 4);
+    if(ok) {
+        size = load_uint32(header);
+        ok = (size <= DAEMON_MAX_MESSAGE_SIZE);
+    }
+    if(ok) {
+        message = malloc((size > 0) ? size : 1);
+        ok = (
+            (message != NULL) && receive_all(daemon, descriptor, message, size)
+        );
+    }
+    // check the fields all fit in the message, and find out what's asked for
+    const uint8_t* cancel_id = NULL;
+    for(size_t offset = 0; ok && (offset < size);) {
+        ok = (size - offset >= 5);
+        size_t field_size = ok ? load_uint32(message + offset + 1) : 0;
+        ok = ok && (field_size <= size - offset - 5);
+        if(ok && (message[offset] == DAEMON_FIELD_CANCEL)) {
+            ok = (field_size == 8);
+            cancel_id = message + offset + 5;
+        }
+        offset += 5 + field_size;
+    }
+    if(!ok) {
+        send_status(descriptor, DAEMON_STATUS_REFUSED);
+        free(message);
+    } else if(cancel_id != NULL) {
+        serve_cancel(daemon, descriptor, cancel_id);
+        free(message);
+    } else {
+        // the job takes the message
+        serve_job(daemon, descriptor, message, size);
+    }
+    close(descriptor);
+    pthread_mutex_lock(&daemon->lock);
+    daemon->connection_count--;
+    pthread_cond_broadcast(&daemon->changed);
+    pthread_mutex_unlock(&daemon->lock);
+    return NULL;
+}
+
+/*
+ * private function, opens a unix socket listening at the given path. a socket
+ * left there by a daemon which is no longer running is replaced.
+ * returns the socket's descriptor, or -1 on failure.
+ */
+static int listen_on_socket(const char* path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path is too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(descriptor == -1) {
+        fprintf(stderr, "%s\n", "Couldn't create socket");
+        return -1;
+    }
+    bool bound = (
+        bind(descriptor, (struct sockaddr*)&address, sizeof(address)) == 0
+    );
+    if(!bound && (errno == EADDRINUSE)) {
+        // only take the path over if nothing is answering on it
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool in_use = (
+            (probe != -1) &&
+            (connect(probe, (struct sockaddr*)&address, sizeof(address)) == 0)
+        );
+        if(probe != -1) {
+            close(probe);
+        }
+        if(in_use) {
+            fprintf(stderr, "A daemon is already serving on %s\n", path);
+            close(descriptor);
+            return -1;
+        }
+        unlink(path);
+        bound = (
+            bind(descriptor, (struct sockaddr*)&address, sizeof(address)) == 0
+        );
+    }
+    if(!bound || (listen(descriptor, SOMAXCONN) != 0)) {
+        fprintf(stderr, "Couldn't listen on socket: %s\n", path);
+        close(descriptor);
+        return -1;
+    }
+    return descriptor;
+}
+
+/*
+ * private function, runs as a daemon serving jobs sent to the unix socket at
+ * the given path, running as many as jobs at once with up to queue_size more
+ * waiting. on SIGTERM or SIGINT it stops taking new jobs, finishes the ones it
+ * has, then returns.
+ * returns true if it stopped cleanly, false if it couldn't start.
+ */
+static bool serve(const char* socket_path, int jobs, size_t queue_size) {
+    struct daemon_t daemon = {
+        .queue = calloc(queue_size, sizeof(struct daemon_job_t*)),
+        .queue_capacity = queue_size, .queue_start = 0, .queue_count = 0,
+        .jobs = NULL, .next_id = 1, .connection_count = 0, .draining = false,
+    };
+    if(daemon.queue == NULL) {
+        fprintf(stderr, "%s\n", "Couldn't allocate memory for job queue");
+        return false;
+    }
+    int listener = listen_on_socket(socket_path);
+    if(listener == -1) {
+        free(daemon.queue);
+        return false;
+    }
+    /*
+     * no SA_RESTART, so that nothing sits in a system call after the signal.
+     * clients hanging up are noticed when sending fails, not with SIGPIPE
+     */
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = request_daemon_stop;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL);
+    pthread_mutex_init(&daemon.lock, NULL);
+    pthread_cond_init(&daemon.changed, NULL);
+    // start the workers, if some can't be started carry on with fewer
+    size_t worker_count = (jobs < 1) ? 1 : (size_t)jobs;
+    pthread_t* workers = calloc(worker_count, sizeof(pthread_t));
+    size_t started = 0;
+    if(workers != NULL) {
+        while(
+            (started < worker_count) &&
+            start_daemon_thread(&workers[started], NULL, daemon_worker, &daemon)
+        ) {
+            started++;
+        }
+    }
+    bool ok = (started > 0);
+    if(!ok) {
+        fprintf(stderr, "%s\n", "Couldn't start any daemon workers");
+    }
+    // hand each client to a thread of its own, until asked to stop
+    while(ok && !daemon_stop_requested) {
+        struct pollfd poll_descriptor = { .fd = listener, .events = POLLIN, };
+        if(poll(&poll_descriptor, 1, DAEMON_POLL_INTERVAL) <= 0) {
+            continue;
+        }
+        int client = accept(listener, NULL, NULL);
+        if(client == -1) {
+            continue;
+        }
+        struct daemon_connection_t* connection = malloc(
+            sizeof(struct daemon_connection_t)
+        );
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+        pthread_t thread;
+        pthread_mutex_lock(&daemon.lock);
+        daemon.connection_count++;
+        pthread_mutex_unlock(&daemon.lock);
+        if(connection != NULL) {
+            connection->daemon = &daemon;
+            connection->descriptor = client;
+        }
+        if(
+            (connection == NULL) ||
+            !start_daemon_thread(
+                &thread, &attributes, serve_connection, connection
+            )
+        ) {
+            free(connection);
+            close(client);
+            pthread_mutex_lock(&daemon.lock);
+            daemon.connection_count--;
+            pthread_mutex_unlock(&daemon.lock);
+        }
+        pthread_attr_destroy(&attributes);
+    }
+    // take no more jobs, but finish all the ones already taken
+    close(listener);
+    unlink(socket_path);
+    pthread_mutex_lock(&daemon.lock);
+    daemon.draining = true;
+    pthread_cond_broadcast(&daemon.changed);
+    pthread_mutex_unlock(&daemon.lock);
+    for(size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    // wait for the results to be sent back
+    pthread_mutex_lock(&daemon.lock);
+    while(daemon.connection_count > 0) {
+        pthread_cond_wait(&daemon.changed, &daemon.lock);
+    }
+    pthread_mutex_unlock(&daemon.lock);
+    pthread_cond_destroy(&daemon.changed);
+    pthread_mutex_destroy(&daemon.lock);
+    free(daemon.queue);
+    return ok;
+}
+
+// main - mostly just process arguments, the bulk of the work is done by run()
+int main(int argc, char* argv[]) {
+    // build argtable struct for parsing command-line arguments
+    struct arguments_t arguments;
+    if(!make_arguments(&arguments)) {
+        // NULL entries were detected, so some allocations failed
+        fprintf(
+            stderr, "%s\n", "FATAL: Could not allocate all entries for argtable"
+        );
+        free_arguments(&arguments);
+        return 2;
+    }
+    struct run_options_t options;
+    int status_code = parse_arguments(
+        &arguments, argc, argv, &options, stdout, stderr
+    );
+    // if at this point status_code is not -1, clean up then return early
+    if(status_code != -1) {
+        free_arguments(&arguments);
+        return status_code;
+    }
+    // otherwise, carry on...
+    bool result = false;
+    // whether the run was stopped early, leaving its output partly done
+    bool stopped = false;
+    if(
+        (arguments.batch->count > 0) && (arguments.stats->count > 0) &&
+        (arguments.jobs->ival[0] > 1)
+    ) {
+        // CPU time and peak memory are the whole program's, not any one job's
+        fprintf(
+            stderr, "%s\n",
+            "Statistics can only be collected in batch mode with -j 1"
+        );
+    } else if(
+        (arguments.batch->count > 0) && (arguments.max_rss->ival[0] > 0) &&
+        (arguments.jobs->ival[0] > 1)
+    ) {
+        // memory use is the whole program's, not that of any one job
+        fprintf(
+            stderr, "%s\n",
+            "A memory budget can only be used in batch mode with -j 1"
+        );
+    } else if(
+        (arguments.batch->count > 0) && (arguments.output->count > 1)
+    ) {
+        // each job has one output of its own
+        fprintf(stderr, "%s\n", "Only one output can be given in batch mode");
+    } else if(
+        (arguments.serve->count > 0) && (arguments.batch->count > 0)
+    ) {
+        fprintf(stderr, "%s\n", "Batch mode can't be used with a daemon");
+    } else if(
+        (arguments.queue_dir->count > 0) &&
+        ((arguments.serve->count > 0) || (arguments.batch->count > 0))
+    ) {
+        fprintf(
+            stderr, "%s\n",
+            "Queue mode can't be used with batch mode or a daemon"
+        );
+    } else if(arguments.serve->count > 0) {
+        // take jobs from clients until told to stop
+        result = serve(
+            *arguments.serve->filename, arguments.jobs->ival[0],
+            (size_t)arguments.queue_size->ival[0]
+        );
+    } else if(!handle_signals()) {
+        fprintf(stderr, "%s\n", "Couldn't start handling signals");
+    } else if(arguments.queue_dir->count > 0) {
+        // work on the queue alongside whoever else is
+        result = run_queue(
+            &options, arguments.queue_dir->sval[0], arguments.lease->ival[0],
+            &stopped
+        );
+    } else if(arguments.batch->count > 0) {
+        // run many jobs with these options
+        result = run_batch(
+            &options, *arguments.batch->filename, arguments.jobs->ival[0],
+            &stopped
+        );
+    } else {
+        // now, call run with options from command-line
+        result = run(&options, &stopped);
+    }
     // free argtable struct
-    arg_freetable(argtable, sizeof(argtable) / sizeof(argtable[0]));
-    // return appropriate status code based on success/failure
-    return (result) ? 0 : 1;
+    free_arguments(&arguments);
+    /*
+     * return appropriate status code based on success/failure, with one of its
+     * own for stopping early so that whoever ran us knows to carry on later
+     */
+    return (!result) ? 1 : (stopped) ? 3 : 0;
 }
 
 #ifdef __cplusplus